@@ -0,0 +1 @@
+#include "AABB.h"
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef RAYTRACING_AABB_H
+#define RAYTRACING_AABB_H
+#include <algorithm>
+#include <limits>
+
+#include "Vector3.h"
+
+// Axis-aligned bounding box
+class AABB {
+public:
+	Vector3 min, max;
+
+	// An empty box, which grows to fit whatever is added to it
+	AABB() : min(std::numeric_limits<Real>::infinity()), max(-std::numeric_limits<Real>::infinity()) {}
+
+	AABB(const Vector3& min, const Vector3& max) : min(min), max(max) {}
+
+	// A box containing all of space, for unbounded objects
+	static AABB everything() {
+		return {Vector3(-std::numeric_limits<Real>::infinity()), Vector3(std::numeric_limits<Real>::infinity())};
+	}
+
+	[[nodiscard]] bool isEmpty() const {return min.x > max.x || min.y > max.y || min.z > max.z;}
+
+	[[nodiscard]] bool isBounded() const {
+		return std::isfinite(min.x) && std::isfinite(min.y) && std::isfinite(min.z) &&
+			std::isfinite(max.x) && std::isfinite(max.y) && std::isfinite(max.z);
+	}
+
+	// Grow the box to contain a point or another box
+	void grow(const Vector3& point) {
+		min = {std::min(min.x, point.x), std::min(min.y, point.y), std::min(min.z, point.z)};
+		max = {std::max(max.x, point.x), std::max(max.y, point.y), std::max(max.z, point.z)};
+	}
+
+	void grow(const AABB& other) {
+		grow(other.min);
+		grow(other.max);
+	}
+
+	[[nodiscard]] Vector3 centroid() const {return min.add(max).scale(0.5);}
+
+	[[nodiscard]] Vector3 extent() const {return max.subtract(min);}
+
+	// Half the surface area, which is all the SAH needs since only ratios are compared
+	[[nodiscard]] Real halfArea() const {
+		if (isEmpty()) return 0;
+		const Vector3 e = extent();
+		return e.x * e.y + e.y * e.z + e.z * e.x;
+	}
+
+	// The axis along which the box is longest
+	[[nodiscard]] int longestAxis() const {
+		const Vector3 e = extent();
+		return e.x > e.y && e.x > e.z ? 0 : e.y > e.z ? 1 : 2;
+	}
+
+	// Squared distance from the point to the nearest point of the box, 0 if the point is inside it
+	[[nodiscard]] Real distanceSquared(const Vector3& point) const {
+		const Vector3 outside(std::max({min.x - point.x, Real(0), point.x - max.x}),
+			std::max({min.y - point.y, Real(0), point.y - max.y}), std::max({min.z - point.z, Real(0), point.z - max.z}));
+		return outside.dot(outside);
+	}
+
+	/*
+	 * Slab test against a ray given by its origin and inverse direction. Returns the distance at which the ray
+	 * enters the box, or infinity if it misses the box or only reaches it beyond tMax.
+	 */
+	[[nodiscard]] Real intersect(const Vector3& origin, const Vector3& invDirection, const Real tMax) const {
+		const Real tx1 = (min.x - origin.x) * invDirection.x, tx2 = (max.x - origin.x) * invDirection.x;
+		const Real ty1 = (min.y - origin.y) * invDirection.y, ty2 = (max.y - origin.y) * invDirection.y;
+		const Real tz1 = (min.z - origin.z) * invDirection.z, tz2 = (max.z - origin.z) * invDirection.z;
+		const Real tNear = std::max({std::min(tx1, tx2), std::min(ty1, ty2), std::min(tz1, tz2), Real(0)});
+		const Real tFar = std::min({std::max(tx1, tx2), std::max(ty1, ty2), std::max(tz1, tz2), tMax});
+		return tNear <= tFar ? tNear : std::numeric_limits<Real>::infinity();
+	}
+};
+
+#endif //RAYTRACING_AABB_H
@@ -0,0 +1 @@
+#include "BVH.h"
\ No newline at end of file
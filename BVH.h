@@ -0,0 +1,361 @@
+#ifndef RAYTRACING_BVH_H
+#define RAYTRACING_BVH_H
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "AABB.h"
+#include "Ray.h"
+#include "RayPacket.h"
+#include "RenderStats.h"
+#include "SphereSoA.h"
+
+/*
+ * Bounding volume hierarchy over a set of bounded primitives, built with binned Surface Area Heuristic splits.
+ * The build reorders the primitives so that every leaf covers a contiguous range of getOrder(). Large builds can
+ * share out subtrees between threads, giving the same hierarchy as building on one.
+ */
+class BVH {
+public:
+	// Interior nodes have count == 0, their first child is the next node and their second child is at offset.
+	// Leaves cover primitives [offset, offset + count) of the build order.
+	struct Node {
+		AABB bounds;
+		std::uint32_t offset = 0;
+		std::uint32_t count = 0;
+	};
+
+	// Leaves never hold more primitives than this, as many as the widest sphere kernel tests in one call
+	static constexpr std::uint32_t MAX_LEAF_SIZE = SphereSoA::MAX_LANES;
+
+	// Leaves are never further than this below the root, which bounds the stacks traversal keeps
+	static constexpr int MAX_DEPTH = 64;
+
+private:
+	static constexpr int BIN_COUNT = 16;
+	// Subtrees over fewer primitives than this are not worth handing to another thread
+	static constexpr std::uint32_t PARALLEL_MIN_COUNT = 16384;
+	// Cost of visiting a node relative to one call of the sphere kernel
+	static constexpr Real TRAVERSAL_COST = 1.0;
+
+	// Cost of intersecting count primitives, which the kernel tests MAX_LEAF_SIZE at a time for about the price of one
+	static Real intersectionCost(const std::uint32_t count) {
+		return static_cast<Real>((count + MAX_LEAF_SIZE - 1) / MAX_LEAF_SIZE);
+	}
+
+	// Levels of median splits needed to bring count primitives down to leaves
+	static int medianLevels(const std::uint32_t count) {
+		return count == 0 ? 0 : static_cast<int>(std::bit_width((count - 1) / MAX_LEAF_SIZE));
+	}
+
+	std::vector<Node> nodes;
+	std::vector<std::uint32_t> order;
+
+	// Primitive bounds and centroids, only kept while building
+	std::vector<AABB> primitiveBounds;
+	std::vector<Vector3> centroids;
+
+	// Append the nodes of a subtree built separately, whose interior nodes refer to their second child by its index
+	// within that subtree
+	static void splice(std::vector<Node>& tree, const std::vector<Node>& subtree) {
+		const auto base = static_cast<std::uint32_t>(tree.size());
+		for (Node node : subtree) {
+			if (node.count == 0) node.offset += base;
+			tree.push_back(node);
+		}
+	}
+
+	/*
+	 * Build the subtree over primitives [first, first + count) of the order onto the end of tree, returning the index
+	 * of its root. With more than one thread, the two children are built at the same time into their own node lists
+	 * and spliced in after, in the order building on one thread would have added them. Once a lopsided run of SAH
+	 * splits leaves only just enough depth for median splits to reach the leaves, median splits are used from there.
+	 */
+	std::uint32_t buildNode(std::vector<Node>& tree, const std::uint32_t first, const std::uint32_t count,
+		const int depth, const unsigned threads) {
+		const auto index = static_cast<std::uint32_t>(tree.size());
+		tree.emplace_back();
+		AABB bounds, centroidBounds;
+		for (std::uint32_t i = first; i < first + count; ++i) {
+			bounds.grow(primitiveBounds[order[i]]);
+			centroidBounds.grow(centroids[order[i]]);
+		}
+		tree[index].bounds = bounds;
+
+		int bestAxis = -1;
+		int bestSplit = 0;
+		const Real leafCost = intersectionCost(count);
+		Real bestCost = leafCost;
+		const bool forceMedian = depth + medianLevels(count) >= MAX_DEPTH;
+		if (count > 1 && !forceMedian) {
+			for (int axis = 0; axis < 3; ++axis) {
+				const Real lo = centroidBounds.min.get(axis);
+				const Real hi = centroidBounds.max.get(axis);
+				if (hi <= lo) continue;
+				const Real scale = BIN_COUNT / (hi - lo);
+
+				// Bin the centroids along this axis
+				std::array<AABB, BIN_COUNT> binBounds;
+				std::array<std::uint32_t, BIN_COUNT> binCounts{};
+				for (std::uint32_t i = first; i < first + count; ++i) {
+					const int bin = std::min(BIN_COUNT - 1, static_cast<int>((centroids[order[i]].get(axis) - lo) * scale));
+					binBounds[bin].grow(primitiveBounds[order[i]]);
+					binCounts[bin]++;
+				}
+
+				// Sweep from the right to get the area and count to the right of every split plane
+				std::array<Real, BIN_COUNT> rightArea{};
+				std::array<std::uint32_t, BIN_COUNT> rightCount{};
+				AABB right;
+				std::uint32_t rightTotal = 0;
+				for (int bin = BIN_COUNT - 1; bin > 0; --bin) {
+					right.grow(binBounds[bin]);
+					rightTotal += binCounts[bin];
+					rightArea[bin] = right.halfArea();
+					rightCount[bin] = rightTotal;
+				}
+
+				// Sweep from the left and evaluate the SAH at every split plane
+				AABB left;
+				std::uint32_t leftTotal = 0;
+				for (int split = 1; split < BIN_COUNT; ++split) {
+					left.grow(binBounds[split - 1]);
+					leftTotal += binCounts[split - 1];
+					if (leftTotal == 0 || rightCount[split] == 0) continue;
+					const Real cost = TRAVERSAL_COST + (left.halfArea() * intersectionCost(leftTotal) +
+						rightArea[split] * intersectionCost(rightCount[split])) / bounds.halfArea();
+					if (cost < bestCost) {
+						bestCost = cost;
+						bestAxis = axis;
+						bestSplit = split;
+					}
+				}
+			}
+		}
+
+		// Make a leaf if no split beats intersecting everything and the leaf is small enough
+		std::uint32_t leftCount;
+		if (bestAxis == -1 || bestCost >= leafCost) {
+			if (count <= MAX_LEAF_SIZE) {
+				tree[index].offset = first;
+				tree[index].count = count;
+				return index;
+			}
+			// Too many primitives for one leaf, so split at the median along the longest axis
+			const int axis = centroidBounds.longestAxis();
+			leftCount = count / 2;
+			std::nth_element(order.begin() + first, order.begin() + first + leftCount, order.begin() + first + count,
+				[&](const std::uint32_t a, const std::uint32_t b) {return centroids[a].get(axis) < centroids[b].get(axis);});
+		} else {
+			// Partition the primitives about the chosen split plane
+			const Real lo = centroidBounds.min.get(bestAxis);
+			const Real scale = BIN_COUNT / (centroidBounds.max.get(bestAxis) - lo);
+			const auto middle = std::partition(order.begin() + first, order.begin() + first + count,
+				[&](const std::uint32_t primitive) {
+					return std::min(BIN_COUNT - 1, static_cast<int>((centroids[primitive].get(bestAxis) - lo) * scale)) < bestSplit;
+				});
+			leftCount = static_cast<std::uint32_t>(middle - (order.begin() + first));
+		}
+
+		if (threads > 1 && count >= PARALLEL_MIN_COUNT) {
+			// The children cover disjoint ranges of the order, so they can be built without locking
+			std::vector<Node> left, right;
+			{
+				std::jthread worker([&] {buildNode(left, first, leftCount, depth + 1, threads / 2);});
+				buildNode(right, first + leftCount, count - leftCount, depth + 1, threads - threads / 2);
+			}
+			splice(tree, left);
+			tree[index].offset = static_cast<std::uint32_t>(tree.size());
+			splice(tree, right);
+			return index;
+		}
+		buildNode(tree, first, leftCount, depth + 1, 1);
+		const std::uint32_t second = buildNode(tree, first + leftCount, count - leftCount, depth + 1, 1);
+		tree[index].offset = second;
+		return index;
+	}
+
+public:
+	// Build the hierarchy over the given primitive bounds on up to the given number of threads, replacing any previous
+	// hierarchy
+	void build(const std::vector<AABB>& bounds, const unsigned threads = 1) {
+		rebuild(bounds, threads);
+		// A hierarchy built once has no more use for the build buffers
+		primitiveBounds.clear();
+		primitiveBounds.shrink_to_fit();
+		centroids.clear();
+		centroids.shrink_to_fit();
+	}
+
+	// Build like build does, but keep the buffers the build works in, so that rebuilding over no more primitives than
+	// before allocates nothing
+	void rebuild(const std::vector<AABB>& bounds, const unsigned threads = 1) {
+		nodes.clear();
+		order.resize(bounds.size());
+		if (bounds.empty()) return;
+		primitiveBounds.assign(bounds.begin(), bounds.end());
+		centroids.clear();
+		centroids.reserve(bounds.size());
+		for (std::uint32_t i = 0; i < bounds.size(); ++i) {
+			order[i] = i;
+			centroids.push_back(bounds[i].centroid());
+		}
+		nodes.reserve(2 * bounds.size());
+		buildNode(nodes, 0, static_cast<std::uint32_t>(bounds.size()), 0, threads);
+	}
+
+	// Restore a hierarchy saved from getNodes() and getOrder(), for the same primitives in the same order
+	void assign(std::vector<Node> nodes, std::vector<std::uint32_t> order) {
+		this->nodes = std::move(nodes);
+		this->order = std::move(order);
+	}
+
+	/*
+	 * Check that nodes and an order read from outside, such as a scene file, form a hierarchy over count primitives
+	 * that traversal can walk without going out of bounds: the order is a permutation of the primitives, leaves cover
+	 * ranges of it, interior nodes only refer forwards and no leaf is deeper than MAX_DEPTH.
+	 */
+	[[nodiscard]] static bool isValid(const std::vector<Node>& nodes, const std::vector<std::uint32_t>& order,
+		const std::size_t count) {
+		if (order.size() != count) return false;
+		std::vector<bool> seen(count);
+		for (const std::uint32_t primitive : order) {
+			if (primitive >= count || seen[primitive]) return false;
+			seen[primitive] = true;
+		}
+		// Children always come after their parent, so depths can be worked out in a single pass
+		std::vector<int> depths(nodes.size());
+		for (size_t i = 0; i < nodes.size(); ++i) {
+			const Node& node = nodes[i];
+			if (depths[i] > MAX_DEPTH) return false;
+			if (node.count > 0) {
+				if (node.offset + static_cast<std::uint64_t>(node.count) > order.size()) return false;
+			} else {
+				if (node.offset <= i + 1 || node.offset >= nodes.size()) return false;
+				depths[i + 1] = std::max(depths[i + 1], depths[i] + 1);
+				depths[node.offset] = std::max(depths[node.offset], depths[i] + 1);
+			}
+		}
+		return true;
+	}
+
+	// The original index of each primitive, in the order the leaves refer to them
+	[[nodiscard]] const std::vector<std::uint32_t>& getOrder() const {return order;}
+
+	[[nodiscard]] const std::vector<Node>& getNodes() const {return nodes;}
+
+	[[nodiscard]] bool isEmpty() const {return nodes.empty();}
+
+	/*
+	 * Walk the hierarchy front to back, calling intersect(first, count) for the primitive positions of every leaf the ray
+	 * reaches before tMax. The callback shortens tMax when it finds a closer hit, and returns true to stop the traversal.
+	 * Starting from a node other than the root only walks that subtree.
+	 */
+	template <typename Intersect>
+	void traverse(const Ray& ray, Real& tMax, Intersect&& intersect, const std::uint32_t root = 0) const {
+		if (nodes.empty()) return;
+		const Vector3 origin = ray.getOrigin();
+		const Vector3 invDirection = ray.getDirection().inv();
+
+		// Holds at most one node for every level above the current one
+		std::uint32_t stack[MAX_DEPTH];
+		int stackSize = 0;
+		std::uint32_t current = root;
+		if (nodes[root].bounds.intersect(origin, invDirection, tMax) == std::numeric_limits<Real>::infinity()) return;
+		while (true) {
+			const Node& node = nodes[current];
+			RenderStats::add(RenderStats::Counter::BVHNodes);
+			if (node.count > 0) {
+				if (intersect(node.offset, node.count)) return;
+			} else {
+				// Visit the nearer child first and push the other one
+				std::uint32_t nearChild = current + 1, farChild = node.offset;
+				Real tNear = nodes[nearChild].bounds.intersect(origin, invDirection, tMax);
+				Real tFar = nodes[farChild].bounds.intersect(origin, invDirection, tMax);
+				if (tFar < tNear) {
+					std::swap(nearChild, farChild);
+					std::swap(tNear, tFar);
+				}
+				if (tNear != std::numeric_limits<Real>::infinity()) {
+					if (tFar != std::numeric_limits<Real>::infinity()) stack[stackSize++] = farChild;
+					current = nearChild;
+					continue;
+				}
+			}
+			// Pop the next node that is still closer than the closest hit
+			bool found = false;
+			while (stackSize > 0) {
+				current = stack[--stackSize];
+				if (nodes[current].bounds.intersect(origin, invDirection, tMax) != std::numeric_limits<Real>::infinity()) {
+					found = true;
+					break;
+				}
+			}
+			if (!found) return;
+		}
+	}
+
+	/*
+	 * Walk the hierarchy with a packet of coherent rays, testing every lane against a node's children at once and
+	 * descending into the nearer child like traverse does, so the lanes share every node fetch and box test. Leaves
+	 * are handed to intersectLeaf(first, count, lanes) with the mask of lanes that reach them. Once only one lane
+	 * reaches a node the packet has diverged, and that lane finishes the subtree on its own through
+	 * traverseSingle(lane, node). As with the callback of traverse, intersectLeaf returns the mask of lanes that are
+	 * done and traverseSingle whether its lane is, and the walk stops once every active lane is done.
+	 */
+	template <typename IntersectLeaf, typename TraverseSingle>
+	void traversePacket(const RayPacket& packet, std::array<Real, RayPacket::SIZE>& tMax, IntersectLeaf&& intersectLeaf,
+		TraverseSingle&& traverseSingle) const {
+		if (nodes.empty()) return;
+		// Nodes still to visit and the lanes that reached them, at most one for every level above the current one
+		struct Pending {
+			std::uint32_t node;
+			unsigned lanes;
+		};
+		Pending stack[MAX_DEPTH];
+		int stackSize = 0;
+		std::uint32_t current = 0;
+		unsigned lanes = packet.intersectBox(nodes[0].bounds, tMax, packet.getActive());
+		unsigned done = 0;
+		while (true) {
+			if (lanes != 0) {
+				const Node& node = nodes[current];
+				RenderStats::add(RenderStats::Counter::BVHNodes);
+				if (std::has_single_bit(lanes)) {
+					if (traverseSingle(std::countr_zero(lanes), current)) done |= lanes;
+				} else if (node.count > 0) {
+					done |= intersectLeaf(node.offset, node.count, lanes);
+				} else {
+					const std::uint32_t first = current + 1, second = node.offset;
+					const unsigned firstLanes = packet.intersectBox(nodes[first].bounds, tMax, lanes);
+					const unsigned secondLanes = packet.intersectBox(nodes[second].bounds, tMax, lanes);
+					if (firstLanes != 0 && secondLanes != 0) {
+						// Visit the child nearer along the packet's direction first and push the other one
+						const Vector3 between = nodes[second].bounds.centroid().subtract(nodes[first].bounds.centroid());
+						const bool secondIsNearer = packet.getDirection().dot(between) < 0;
+						stack[stackSize++] = secondIsNearer ? Pending{first, firstLanes} : Pending{second, secondLanes};
+						current = secondIsNearer ? second : first;
+						lanes = secondIsNearer ? secondLanes : firstLanes;
+						continue;
+					}
+					if ((firstLanes | secondLanes) != 0) {
+						current = firstLanes != 0 ? first : second;
+						lanes = firstLanes | secondLanes;
+						continue;
+					}
+				}
+			}
+			// Pop the next node that some of its lanes still reach before their closest hit
+			if (stackSize == 0 || (packet.getActive() & ~done) == 0) return;
+			const Pending next = stack[--stackSize];
+			current = next.node;
+			lanes = packet.intersectBox(nodes[current].bounds, tMax, next.lanes & ~done);
+		}
+	}
+};
+
+#endif //RAYTRACING_BVH_H
@@ -4,41 +4,169 @@
 
 #ifndef RAYTRACING_CAMERA_H
 #define RAYTRACING_CAMERA_H
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
 #include "Ray.h"
+#include "RealLanes.h"
 #include "Vector3.h"
 
 
+// Where the camera is and how it is pointed, as given by the scene
+struct CameraSettings {
+    // Horizontal field of view the camera has when the scene does not set one, in degrees
+    static constexpr Real DEFAULT_FOV = 23.40183901630756;
+
+    Vector3 position = Vector3(0);
+    // Point the centre of the image looks at
+    Vector3 lookAt = Vector3(0, 0, 1);
+    // Rough upwards direction, only needs to not be parallel to the view direction
+    Vector3 up = Vector3(0, 1, 0);
+
+    // Horizontal field of view in degrees
+    Real fov = DEFAULT_FOV;
+
+    // Aspect ratio of the image plane - ratio of width to height. 0 matches the image, giving square pixels.
+    Real aspectRatio = 0;
+
+    // Throw std::invalid_argument if the camera has no view direction, or up gives no sideways direction from it
+    void validate() const {
+        const Vector3 view = lookAt.subtract(position);
+        if (!(view.dot(view) > 0)) throw std::invalid_argument("camera looks at its own position");
+        const Vector3 side = up.cross(view);
+        if (!(side.dot(side) > 0)) throw std::invalid_argument("camera up direction is parallel to its view direction");
+    }
+};
+
 class Camera {
 public:
-    // Horizontal field of view in degrees
-    double fov = 45;
+    // How a camera ray's origin and direction change from one pixel to the next, for filtering over a pixel footprint
+    struct RayDifferential {
+        Vector3 dOdx, dOdy;
+        Vector3 dDdx, dDdy;
+    };
 
-    // Aspect ration of image - ratio of width to height
-    double aspectRatio;
+    using Kernel = void (*)(const Camera&, int x0, int x1, int y, std::vector<Ray>&);
 
-    //Dimensions of image plane in pixels (px) - i.e. screen units
 private:
-        int width_px, height_px;
+    Vector3 origin;
 
-    // Dimensions of image plane in metres (m) - i.e. world units
-        double width_m, height_m;
-        // The distance in world units between each screen-space pixel
-        double x_step_m, y_step_m;
+    // Unnormalised direction through the centre of the top left pixel, at unit distance along the view direction,
+    // and the change in direction from one pixel to the next along a row and down a column
+    Vector3 topLeft, stepX, stepY;
+
+    // Direction through the centre of pixel (x, y) before normalising. Both kernels add up the terms in this order.
+    [[nodiscard]] Vector3 directionAt(const int x, const int y) const {
+        return topLeft.add(stepY.scale(y)).add(stepX.scale(x));
+    }
+
+    static void scalarKernel(const Camera& camera, const int x0, const int x1, const int y, std::vector<Ray>& rays) {
+        for (int x = x0; x < x1; ++x) {rays.push_back(camera.castRay(x, y));}
+    }
+
+#ifdef RAYTRACING_X86_LANES
+    __attribute__((target("avx2")))
+    static void avx2Kernel(const Camera& camera, const int x0, const int x1, const int y, std::vector<Ray>& rays) {
+        using namespace RealLanes;
+        const Vector3 row = camera.topLeft.add(camera.stepY.scale(y));
+        const Lanes rowX = set1(row.x), rowY = set1(row.y), rowZ = set1(row.z);
+        const Lanes stepX = set1(camera.stepX.x), stepY = set1(camera.stepX.y), stepZ = set1(camera.stepX.z);
+        // Directions are computed a chunk at a time and only then copied into rays, so the copies read back values
+        // stored a while ago rather than stalling on the vector stores just made
+        constexpr int CHUNK = 64;
+        Real offsets[WIDTH], dx[CHUNK], dy[CHUNK], dz[CHUNK];
+        for (int lane = 0; lane < WIDTH; ++lane) {offsets[lane] = static_cast<Real>(lane);}
+        Lanes column = add(set1(static_cast<Real>(x0)), load(offsets));
+        const Lanes advance = set1(static_cast<Real>(WIDTH));
+        int x = x0;
+        while (x + WIDTH <= x1) {
+            const int chunk = std::min(CHUNK, (x1 - x) / WIDTH * WIDTH);
+            for (int i = 0; i < chunk; i += WIDTH, column = add(column, advance)) {
+                const Lanes directionX = add(rowX, mul(stepX, column));
+                const Lanes directionY = add(rowY, mul(stepY, column));
+                const Lanes directionZ = add(rowZ, mul(stepZ, column));
+                const Lanes length = RealLanes::sqrt(dot(directionX, directionY, directionZ, directionX, directionY,
+                    directionZ));
+                store(dx + i, div(directionX, length));
+                store(dy + i, div(directionY, length));
+                store(dz + i, div(directionZ, length));
+            }
+            for (int i = 0; i < chunk; ++i) {rays.emplace_back(camera.origin, Vector3(dx[i], dy[i], dz[i]));}
+            x += chunk;
+        }
+        scalarKernel(camera, x, x1, y, rays);
+    }
+#endif
+
+    // Pick the widest kernel the CPU supports
+    static Kernel selectKernel() {
+#ifdef RAYTRACING_X86_LANES
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return avx2Kernel;
+#endif
+        return scalarKernel;
+    }
+
+    inline static const Kernel kernel = selectKernel();
 
 public:
-    Camera(const int width, const int height) :
-        aspectRatio(static_cast<double>(width) / static_cast<double>(height)),width_px(width),height_px(height),
-        width_m(tan(fov * M_PI/ 360)),height_m(width_m / aspectRatio),
-        x_step_m(width_m/width_px),y_step_m(height_m/height_px) {}
+    /*
+     * Set up the camera for an image of the given size in pixels. The image plane sits at unit distance along the
+     * view direction, so its width follows from the field of view, and each pixel's ray passes through its centre.
+     * Throws std::invalid_argument if the settings give no view, see CameraSettings::validate.
+     */
+    Camera(const CameraSettings& settings, const int width, const int height) : origin(settings.position),
+        topLeft(0), stepX(0), stepY(0) {
+        settings.validate();
+        const Real aspectRatio = settings.aspectRatio > 0 ? settings.aspectRatio
+            : static_cast<Real>(width) / static_cast<Real>(height);
+
+        // Orthonormal basis: w forwards, u to the right and v upwards on the image
+        const Vector3 w = settings.lookAt.subtract(settings.position).normalised();
+        const Vector3 u = settings.up.cross(w).normalised();
+        const Vector3 v = w.cross(u);
+
+        // Dimensions of image plane in world units
+        const Real width_m = 2 * std::tan(settings.fov * static_cast<Real>(M_PI / 360));
+        const Real height_m = width_m / aspectRatio;
+        // The distance in world units between each screen-space pixel
+        const Real x_step_m = width_m / width, y_step_m = height_m / height;
+
+        stepX = u.scale(x_step_m);
+        stepY = v.scale(-y_step_m);
+        topLeft = w.add(u.scale((x_step_m - width_m) / 2)).add(v.scale((height_m - y_step_m) / 2));
+    }
+
+    // The default camera, at the origin looking along +z
+    Camera(const int width, const int height) : Camera(CameraSettings(), width, height) {}
 
     // Casts a ray through a supplied pixel coordinate
-    [[nodiscard]] Ray castRay(int x, int y) const {
-        const double x_pos = (x_step_m - width_m) / 2 + x * x_step_m;
-        const double y_pos = (y_step_m + height_m) / 2 - y * y_step_m;
-        return { Vector3(0, 0, 0), (new Vector3(x_pos, y_pos, 1))->normalised()};
+    [[nodiscard]] Ray castRay(const int x, const int y) const {
+        return {origin, directionAt(x, y).normalised()};
+    }
+
+    // Append the rays through pixels [x0, x1) of row y, several at a time when the CPU allows
+    void castRays(const int x0, const int x1, const int y, std::vector<Ray>& rays) const {
+        kernel(*this, x0, x1, y, rays);
+    }
+
+    /*
+     * Differentials of the ray through pixel (x, y) with respect to the pixel coordinates. Every ray starts at the
+     * camera position, so only the normalised direction changes: dD = (dd (d.d) - d (d.dd)) / |d|^3.
+     */
+    [[nodiscard]] RayDifferential getDifferential(const int x, const int y) const {
+        const Vector3 d = directionAt(x, y);
+        const Real lengthSquared = d.dot(d);
+        const Real invLengthCubed = 1 / (lengthSquared * std::sqrt(lengthSquared));
+        auto differentiate = [&](const Vector3& step) {
+            return step.scale(lengthSquared).subtract(d.scale(d.dot(step))).scale(invLengthCubed);
+        };
+        return {Vector3(0), Vector3(0), differentiate(stepX), differentiate(stepY)};
     }
 };
 
 
 
-#endif //RAYTRACING_CAMERA_H
\ No newline at end of file
+#endif //RAYTRACING_CAMERA_H
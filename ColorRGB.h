@@ -9,50 +9,52 @@
 #include "Vector3.h"
 #include "SDL3/SDL_stdinc.h"
 
-class ColorRGB {
+// RGB colour over a scalar type T, use the ColorRGB alias for the build's precision
+template <typename T>
+class ColorRGBT {
 
     // Vector3 member field
 private:
-    Vector3 v;
-    ColorRGB(Vector3 vec) : // Private constructor
+    Vector3T<T> v;
+    ColorRGBT(Vector3T<T> vec) : // Private constructor
     v(vec) {}
-    static Uint8 convertToByte(double value) { // Private method
-        return 255 * std::max(static_cast<double>(0), std::ranges::min( static_cast<double>(1), value));}
+    static Uint8 convertToByte(T value) { // Private method
+        return 255 * std::max(static_cast<T>(0), std::ranges::min( static_cast<T>(1), value));}
 
     // RGB Colour components
 public :
-    [[nodiscard]] double r() const {return v.x;}
-    [[nodiscard]] double g() const {return v.y;}
-    [[nodiscard]] double b() const {return v.z;}
+    [[nodiscard]] T r() const {return v.x;}
+    [[nodiscard]] T g() const {return v.y;}
+    [[nodiscard]] T b() const {return v.z;}
 
     [[nodiscard]] int rAsByte() const {return convertToByte(r());}
     [[nodiscard]] int gAsByte() const {return convertToByte(g());}
     [[nodiscard]] int bAsByte() const {return convertToByte(b());}
-    explicit ColorRGB(const double uniform) : v(uniform) {}
+    explicit ColorRGBT(const T uniform) : v(uniform) {}
 
-    ColorRGB(double red, double green, double blue) : v(red, green, blue) {}
+    ColorRGBT(T red, T green, T blue) : v(red, green, blue) {}
 
     /*
      *  Add, subtract, scale, equals methods as in Vector3
      */
-    [[nodiscard]] ColorRGB add(ColorRGB other) const {return {v.add(other.v)};}
+    [[nodiscard]] ColorRGBT add(ColorRGBT other) const {return {v.add(other.v)};}
 
-    [[nodiscard]] ColorRGB add(double other) const {return {v.add(other)};}
+    [[nodiscard]] ColorRGBT add(T other) const {return {v.add(other)};}
 
-    [[nodiscard]] ColorRGB subtract(ColorRGB other) const {return {v.subtract(other.v)};}
+    [[nodiscard]] ColorRGBT subtract(ColorRGBT other) const {return {v.subtract(other.v)};}
 
-    [[nodiscard]] ColorRGB subtract(double other) const {return {v.subtract(other)};}
+    [[nodiscard]] ColorRGBT subtract(T other) const {return {v.subtract(other)};}
 
-    [[nodiscard]] ColorRGB scale(double scalar) const {return {v.scale(scalar)};}
+    [[nodiscard]] ColorRGBT scale(T scalar) const {return {v.scale(scalar)};}
 
-    [[nodiscard]] ColorRGB scale(ColorRGB other) const {return {v.scale(other.v)};}
+    [[nodiscard]] ColorRGBT scale(ColorRGBT other) const {return {v.scale(other.v)};}
 
-    [[nodiscard]] ColorRGB power(double e) const { return {v.power(e)}; }
+    [[nodiscard]] ColorRGBT power(T e) const { return {v.power(e)}; }
 
-    [[nodiscard]] ColorRGB inv() const {return{v.inv()};}
+    [[nodiscard]] ColorRGBT inv() const {return{v.inv()};}
 
 
-    [[nodiscard]] bool equals(ColorRGB other) const {return v.equals(other.v);}
+    [[nodiscard]] bool equals(ColorRGBT other) const {return v.equals(other.v);}
 
     [[nodiscard]] bool isZero() const {return (r()==0 && g()==0 && b()==0);}
 
@@ -64,4 +66,6 @@ public :
     return convertToByte(r()) << 16 | convertToByte(g()) << 8 | convertToByte(b()) << 0;}
 };
 
+using ColorRGB = ColorRGBT<Real>;
+
 #endif //RAYTRACING_COLORRGB_H
\ No newline at end of file
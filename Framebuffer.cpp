@@ -0,0 +1 @@
+#include "Framebuffer.h"
@@ -0,0 +1,79 @@
+#ifndef RAYTRACING_FRAMEBUFFER_H
+#define RAYTRACING_FRAMEBUFFER_H
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+#include "ColorRGB.h"
+
+/*
+ * High dynamic range float accumulation buffer for a band of image rows. Each colour channel is stored as its own
+ * plane with rows padded to a whole number of cache lines, so tiles never share a line with another tile's row and
+ * the resolve pass can stream through each channel with aligned vector loads.
+ */
+class Framebuffer {
+public:
+	// Alignment of every row, in bytes
+	static constexpr std::size_t ALIGNMENT = 64;
+	static constexpr int CHANNELS = 3;
+
+private:
+	struct AlignedDelete {
+		void operator()(float* data) const {::operator delete[](data, std::align_val_t(ALIGNMENT));}
+	};
+
+	int width, height;
+	// Image row held in the first row of the buffer, for buffers covering a band of a larger image
+	int firstRow;
+	// Floats between the starts of consecutive rows
+	std::size_t stride;
+	std::unique_ptr<float[], AlignedDelete> data;
+	// Number of passes accumulated since the last clear
+	int passes = 0;
+
+public:
+	Framebuffer(const int width, const int height, const int firstRow = 0) : width(width), height(height),
+		firstRow(firstRow), stride((width + ALIGNMENT / sizeof(float) - 1) / (ALIGNMENT / sizeof(float)) *
+		(ALIGNMENT / sizeof(float))),
+		data(static_cast<float*>(::operator new[](CHANNELS * stride * height * sizeof(float), std::align_val_t(ALIGNMENT)))) {
+		clear();
+	}
+
+	// Zero every pixel and forget the accumulated passes
+	void clear() {
+		std::fill_n(data.get(), CHANNELS * stride * height, 0.0f);
+		passes = 0;
+	}
+
+	// Move the buffer to cover a different band of rows, keeping its size
+	void setFirstRow(const int firstRow) {this->firstRow = firstRow;}
+
+	// Add a traced colour to the pixel at image coordinates (x, y)
+	void accumulate(const int x, const int y, const ColorRGB& colour) {
+		const std::size_t offset = static_cast<std::size_t>(y - firstRow) * stride + x;
+		float* pixel = data.get() + offset;
+		const std::size_t plane = stride * height;
+		pixel[0] += static_cast<float>(colour.r());
+		pixel[plane] += static_cast<float>(colour.g());
+		pixel[2 * plane] += static_cast<float>(colour.b());
+	}
+
+	// Mark a full pass over the image as finished
+	void endPass() {passes++;}
+
+	[[nodiscard]] int getPasses() const {return passes;}
+
+	[[nodiscard]] int getWidth() const {return width;}
+
+	[[nodiscard]] int getHeight() const {return height;}
+
+	[[nodiscard]] int getFirstRow() const {return firstRow;}
+
+	// One channel of a buffer row, aligned to ALIGNMENT and padded to a multiple of it
+	[[nodiscard]] const float* row(const int channel, const int y) const {
+		return data.get() + channel * stride * height + static_cast<std::size_t>(y) * stride;
+	}
+};
+
+#endif //RAYTRACING_FRAMEBUFFER_H
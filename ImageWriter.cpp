@@ -0,0 +1,18 @@
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <cctype>
+
+#include "PNGWriter.h"
+#include "PPMWriter.h"
+#include "QOIWriter.h"
+
+std::unique_ptr<ImageWriter> ImageWriter::forPath(const std::string& path) {
+	const size_t dot = path.find_last_of('.');
+	std::string extension = dot == std::string::npos ? "" : path.substr(dot + 1);
+	std::ranges::transform(extension, extension.begin(), [](const unsigned char c) {return std::tolower(c);});
+	if (extension == "ppm") return std::make_unique<PPMWriter>(path);
+	if (extension == "png") return std::make_unique<PNGWriter>(path);
+	if (extension == "qoi") return std::make_unique<QOIWriter>(path);
+	throw std::runtime_error("unknown image format for " + path + ", expected .ppm, .png or .qoi");
+}
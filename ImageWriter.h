@@ -0,0 +1,59 @@
+#ifndef RAYTRACING_IMAGEWRITER_H
+#define RAYTRACING_IMAGEWRITER_H
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+/*
+ * Writes an RGB24 image to a file as it is rendered. Rows are handed over top to bottom in bands, so an encoder only
+ * ever sees one band of the image at a time and never needs the whole frame in memory.
+ */
+class ImageWriter {
+protected:
+	std::ofstream out;
+	std::string path;
+	int width = 0, height = 0;
+
+	void write(const void* data, const size_t size) {
+		out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+		if (!out) throw std::runtime_error("error writing " + path);
+	}
+
+	void writeByte(const std::uint8_t byte) {write(&byte, 1);}
+
+	// Write a 32 bit value most significant byte first, as PNG and QOI both store them
+	void writeBigEndian(const std::uint32_t value) {
+		const std::uint8_t bytes[4] = {static_cast<std::uint8_t>(value >> 24), static_cast<std::uint8_t>(value >> 16),
+			static_cast<std::uint8_t>(value >> 8), static_cast<std::uint8_t>(value)};
+		write(bytes, 4);
+	}
+
+public:
+	explicit ImageWriter(const std::string& path) : out(path, std::ios::binary), path(path) {
+		if (!out) throw std::runtime_error("cannot open " + path + " for writing");
+	}
+
+	virtual ~ImageWriter() = default;
+
+	// Start an image of the given size, before any rows are written
+	virtual void begin(const int width, const int height) {
+		this->width = width;
+		this->height = height;
+	}
+
+	// Append the next rows of the image, each pitch bytes apart and holding width RGB24 pixels
+	virtual void writeRows(const std::uint8_t* pixels, int rows, int pitch) = 0;
+
+	// Finish the file once every row has been written
+	virtual void finish() {
+		out.flush();
+		if (!out) throw std::runtime_error("error writing " + path);
+	}
+
+	// Pick a writer from the file extension: .ppm, .png or .qoi
+	static std::unique_ptr<ImageWriter> forPath(const std::string& path);
+};
+
+#endif //RAYTRACING_IMAGEWRITER_H
@@ -0,0 +1 @@
+#include "Intersection.h"
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef RAYTRACING_INTERSECTION_H
+#define RAYTRACING_INTERSECTION_H
+#include <cstdint>
+#include <limits>
+
+#include "Real.h"
+
+// The kinds of primitive the scene stores, each in its own array
+enum class PrimitiveType : std::uint8_t {None, Sphere, Plane};
+
+/*
+ * Result of the first phase of a scene query: just the distance along the ray and which primitive was hit.
+ * Surface attributes are only evaluated afterwards, for the closest hit.
+ */
+struct Intersection {
+    Real distance = std::numeric_limits<Real>::infinity();
+
+    // Which array the primitive hit is in, and its index there
+    PrimitiveType type = PrimitiveType::None;
+    std::uint32_t index = 0;
+
+    [[nodiscard]] bool isHit() const {return type != PrimitiveType::None;}
+};
+
+#endif //RAYTRACING_INTERSECTION_H
@@ -0,0 +1 @@
+#include "LightSoA.h"
@@ -0,0 +1,152 @@
+#ifndef RAYTRACING_LIGHTSOA_H
+#define RAYTRACING_LIGHTSOA_H
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "PointLight.h"
+#include "RealLanes.h"
+#include "Vector3.h"
+
+/*
+ * Light positions, colours and radiant intensities in structure-of-arrays layout. Lights are evaluated against a
+ * shading point in batches, several lights per instruction when the CPU allows, producing the unshadowed geometric
+ * terms of the Phong model for each one.
+ */
+class LightSoA {
+public:
+	// Number of lights evaluated per call, the arrays the terms go into must hold this many
+	static constexpr std::uint32_t BATCH = 16;
+
+	// The view of a surface point that the lights are evaluated against
+	struct ShadingPoint {
+		Vector3 position;
+		// Unit surface normal
+		Vector3 normal;
+		// Unit vector from the surface towards the viewer
+		Vector3 view;
+	};
+
+	// Unshadowed terms of a batch of lights, indexed by position in the batch
+	struct Terms {
+		Real distance[BATCH];
+		// Unit vector from the surface towards the light
+		Real lx[BATCH], ly[BATCH], lz[BATCH];
+		// N.L and R.V, with R the light direction reflected in the normal
+		Real nDotL[BATCH], rDotV[BATCH];
+		// Inverse square falloff
+		Real falloff[BATCH];
+	};
+
+	using Kernel = void (*)(const LightSoA&, const ShadingPoint&, std::uint32_t first, std::uint32_t count, Terms&);
+
+private:
+	std::vector<Real> px, py, pz;
+	// Colour of each light
+	std::vector<Real> cr, cg, cb;
+	// Colour times intensity over 4 pi
+	std::vector<Real> ir, ig, ib;
+	std::uint32_t count = 0;
+
+	static void scalarKernel(const LightSoA& lights, const ShadingPoint& point, const std::uint32_t first,
+		const std::uint32_t count, Terms& terms) {
+		const Vector3& P = point.position;
+		const Vector3& N = point.normal;
+		const Vector3& V = point.view;
+		const Real nDotV = N.dot(V);
+		for (std::uint32_t i = 0; i < count; ++i) {
+			const Real dx = lights.px[first + i] - P.x, dy = lights.py[first + i] - P.y, dz = lights.pz[first + i] - P.z;
+			const Real distanceSquared = dx * dx + dy * dy + dz * dz;
+			const Real distance = std::sqrt(distanceSquared);
+			const Real lx = dx / distance, ly = dy / distance, lz = dz / distance;
+			const Real nDotL = N.x * lx + N.y * ly + N.z * lz;
+			terms.distance[i] = distance;
+			terms.lx[i] = lx;
+			terms.ly[i] = ly;
+			terms.lz[i] = lz;
+			terms.nDotL[i] = nDotL;
+			// R = 2(L.N)N - L, so R.V = 2(L.N)(N.V) - L.V
+			terms.rDotV[i] = 2 * nDotL * nDotV - (V.x * lx + V.y * ly + V.z * lz);
+			terms.falloff[i] = 1 / distanceSquared;
+		}
+	}
+
+#ifdef RAYTRACING_X86_LANES
+	__attribute__((target("avx2")))
+	static void avx2Kernel(const LightSoA& lights, const ShadingPoint& point, const std::uint32_t first,
+		const std::uint32_t count, Terms& terms) {
+		using namespace RealLanes;
+		const Vector3& P = point.position;
+		const Vector3& N = point.normal;
+		const Vector3& V = point.view;
+		const Lanes pX = set1(P.x), pY = set1(P.y), pZ = set1(P.z);
+		const Lanes nX = set1(N.x), nY = set1(N.y), nZ = set1(N.z);
+		const Lanes vX = set1(V.x), vY = set1(V.y), vZ = set1(V.z);
+		const Lanes twoNDotV = set1(2 * N.dot(V)), one = set1(1);
+		// The arrays are padded to a whole batch, so lanes past count read padding and are simply ignored
+		for (std::uint32_t i = 0; i < count; i += WIDTH) {
+			const Lanes dx = sub(load(&lights.px[first + i]), pX);
+			const Lanes dy = sub(load(&lights.py[first + i]), pY);
+			const Lanes dz = sub(load(&lights.pz[first + i]), pZ);
+			const Lanes distanceSquared = dot(dx, dy, dz, dx, dy, dz);
+			const Lanes distance = RealLanes::sqrt(distanceSquared);
+			const Lanes lx = div(dx, distance), ly = div(dy, distance), lz = div(dz, distance);
+			const Lanes nDotL = dot(nX, nY, nZ, lx, ly, lz);
+			store(terms.distance + i, distance);
+			store(terms.lx + i, lx);
+			store(terms.ly + i, ly);
+			store(terms.lz + i, lz);
+			store(terms.nDotL + i, nDotL);
+			store(terms.rDotV + i, sub(mul(nDotL, twoNDotV), dot(vX, vY, vZ, lx, ly, lz)));
+			store(terms.falloff + i, div(one, distanceSquared));
+		}
+	}
+#endif
+
+	// Pick the widest kernel the CPU supports
+	static Kernel selectKernel() {
+#ifdef RAYTRACING_X86_LANES
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) return avx2Kernel;
+#endif
+		return scalarKernel;
+	}
+
+	inline static const Kernel kernel = selectKernel();
+
+public:
+	// Copy the lights into the arrays, in the order given
+	void assign(const std::span<const LightPrimitive> lights) {
+		count = static_cast<std::uint32_t>(lights.size());
+		// The padding only keeps vector loads in bounds, whatever the kernels compute for it is never read
+		const size_t padded = (lights.size() + BATCH - 1) / BATCH * BATCH + BATCH;
+		for (std::vector<Real>* array : {&px, &py, &pz, &cr, &cg, &cb, &ir, &ig, &ib}) {array->assign(padded, 0);}
+		for (size_t i = 0; i < lights.size(); ++i) {
+			px[i] = lights[i].position.x;
+			py[i] = lights[i].position.y;
+			pz[i] = lights[i].position.z;
+			cr[i] = lights[i].colour.r();
+			cg[i] = lights[i].colour.g();
+			cb[i] = lights[i].colour.b();
+			ir[i] = lights[i].radiantIntensity.r();
+			ig[i] = lights[i].radiantIntensity.g();
+			ib[i] = lights[i].radiantIntensity.b();
+		}
+	}
+
+	[[nodiscard]] std::uint32_t size() const {return count;}
+
+	[[nodiscard]] ColorRGB getColour(const std::uint32_t i) const {return {cr[i], cg[i], cb[i]};}
+
+	[[nodiscard]] ColorRGB getRadiantIntensity(const std::uint32_t i) const {return {ir[i], ig[i], ib[i]};}
+
+	// Evaluate lights [first, first + count) against the point, count being at most BATCH. The first light can be
+	// any light, not just the start of a batch.
+	void evaluate(const ShadingPoint& point, const std::uint32_t first, const std::uint32_t count, Terms& terms) const {
+		kernel(*this, point, first, std::min(count, BATCH), terms);
+	}
+};
+
+#endif //RAYTRACING_LIGHTSOA_H
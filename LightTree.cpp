@@ -0,0 +1 @@
+#include "LightTree.h"
@@ -0,0 +1,138 @@
+#ifndef RAYTRACING_LIGHTTREE_H
+#define RAYTRACING_LIGHTTREE_H
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "AABB.h"
+#include "BVH.h"
+#include "PointLight.h"
+
+/*
+ * Hierarchy over the lights for picking one at random in proportion to how much it is likely to contribute at a
+ * shading point. Every node knows the total power of the lights below it, and a node's importance is that power
+ * over the squared distance to its bounds, following the inverse square falloff of the lights themselves. Any light
+ * that can contribute is picked with a non-zero probability, and that probability is returned with it, so dividing
+ * by it gives an unbiased estimate of the sum over all lights.
+ */
+class LightTree {
+public:
+	struct Sample {
+		// Index of the light in the list the tree was built over
+		std::uint32_t light;
+		// Probability of having picked it
+		Real pdf;
+	};
+
+private:
+	BVH bvh;
+	// Total power of the lights under each BVH node
+	std::vector<Real> nodePower;
+	// Light positions and powers in the BVH's leaf order
+	std::vector<Vector3> positions;
+	std::vector<Real> powers;
+	// Light bounds handed to the BVH, kept so that rebuilding the tree allocates nothing once it has grown
+	std::vector<AABB> lightBounds;
+
+	// Scalar power of a light, the mean of its radiant intensity over the channels
+	static Real powerOf(const LightPrimitive& light) {
+		const ColorRGB& I = light.radiantIntensity;
+		return (I.r() + I.g() + I.b()) / 3;
+	}
+
+	// Estimated contribution of a node at a point. Inside or close to the node the distance is clamped to the
+	// node's size, since its lights could then be anywhere around the point.
+	[[nodiscard]] Real importance(const std::uint32_t node, const Vector3& point) const {
+		const AABB& bounds = bvh.getNodes()[node].bounds;
+		const Vector3 toCentre = bounds.centroid().subtract(point);
+		const Vector3 halfExtent = bounds.extent().scale(0.5);
+		const Real distanceSquared = std::max(toCentre.dot(toCentre), halfExtent.dot(halfExtent));
+		return distanceSquared > 0 ? nodePower[node] / distanceSquared : nodePower[node];
+	}
+
+	Real sumPower(const std::uint32_t node) {
+		const BVH::Node& n = bvh.getNodes()[node];
+		Real power = 0;
+		if (n.count > 0) {
+			for (std::uint32_t i = n.offset; i < n.offset + n.count; ++i) {power += powers[i];}
+		} else {
+			power = sumPower(node + 1) + sumPower(n.offset);
+		}
+		return nodePower[node] = power;
+	}
+
+public:
+	/*
+	 * Build the tree over the lights, replacing any previous tree. Its storage is reused, so a tree rebuilt over no
+	 * more lights than before, as each render thread does for the lights of every tile, allocates nothing.
+	 */
+	void build(const std::span<const LightPrimitive> lights) {
+		lightBounds.clear();
+		for (const LightPrimitive& light : lights) {lightBounds.emplace_back(light.position, light.position);}
+		bvh.rebuild(lightBounds);
+		positions.clear();
+		powers.clear();
+		for (const std::uint32_t index : bvh.getOrder()) {
+			positions.push_back(lights[index].position);
+			powers.push_back(powerOf(lights[index]));
+		}
+		nodePower.assign(bvh.getNodes().size(), 0);
+		if (!bvh.isEmpty()) sumPower(0);
+	}
+
+	[[nodiscard]] bool isEmpty() const {return bvh.isEmpty();}
+
+	/*
+	 * Pick a light for the shading point using a uniform random number u in [0, 1). The number is reused at every
+	 * level by rescaling the part of [0, 1) that chose the branch back up to [0, 1).
+	 */
+	[[nodiscard]] Sample sample(const Vector3& point, Real u) const {
+		const std::vector<BVH::Node>& nodes = bvh.getNodes();
+		Real pdf = 1;
+		std::uint32_t current = 0;
+		while (nodes[current].count == 0) {
+			const std::uint32_t first = current + 1, second = nodes[current].offset;
+			const Real firstImportance = importance(first, point), secondImportance = importance(second, point);
+			const Real total = firstImportance + secondImportance;
+			// With nothing to choose between, split evenly so neither side is ruled out
+			const Real pFirst = total > 0 ? firstImportance / total : static_cast<Real>(0.5);
+			if (u < pFirst) {
+				u = u / pFirst;
+				pdf *= pFirst;
+				current = first;
+			} else {
+				u = (u - pFirst) / (1 - pFirst);
+				pdf *= 1 - pFirst;
+				current = second;
+			}
+			u = std::min(u, static_cast<Real>(1) - std::numeric_limits<Real>::epsilon());
+		}
+
+		// Pick within the leaf by each light's own estimate
+		const BVH::Node& leaf = nodes[current];
+		Real weights[BVH::MAX_LEAF_SIZE];
+		Real total = 0;
+		for (std::uint32_t i = 0; i < leaf.count; ++i) {
+			const Vector3 toLight = positions[leaf.offset + i].subtract(point);
+			const Real distanceSquared = toLight.dot(toLight);
+			weights[i] = distanceSquared > 0 ? powers[leaf.offset + i] / distanceSquared : powers[leaf.offset + i];
+			total += weights[i];
+		}
+		// Rounding can leave u just past the last boundary, so default to the last light that can be picked
+		std::uint32_t chosen = 0;
+		Real pChosen = 0, cumulative = 0;
+		for (std::uint32_t i = 0; i < leaf.count; ++i) {
+			const Real p = total > 0 ? weights[i] / total : static_cast<Real>(1) / leaf.count;
+			if (p == 0) continue;
+			chosen = i;
+			pChosen = p;
+			if (u < cumulative + p) break;
+			cumulative += p;
+		}
+		return {bvh.getOrder()[leaf.offset + chosen], pdf * pChosen};
+	}
+};
+
+#endif //RAYTRACING_LIGHTTREE_H
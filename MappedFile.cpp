@@ -0,0 +1,69 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path) {
+	const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("cannot open " + path);
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		throw std::runtime_error("cannot read the size of " + path);
+	}
+	size = static_cast<std::size_t>(fileSize.QuadPart);
+	// An empty file cannot be mapped, and has nothing to map anyway
+	if (size > 0) {
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping != nullptr) data = static_cast<const std::byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	}
+	CloseHandle(file);
+	if (size > 0 && data == nullptr) {
+		if (mapping != nullptr) CloseHandle(mapping);
+		throw std::runtime_error("cannot map " + path + " into memory");
+	}
+}
+
+MappedFile::~MappedFile() {
+	if (data != nullptr) UnmapViewOfFile(data);
+	if (mapping != nullptr) CloseHandle(mapping);
+}
+#else
+MappedFile::MappedFile(const std::string& path) {
+	const int file = open(path.c_str(), O_RDONLY);
+	if (file < 0) throw std::runtime_error("cannot open " + path);
+	struct stat status {};
+	if (fstat(file, &status) != 0) {
+		close(file);
+		throw std::runtime_error("cannot read the size of " + path);
+	}
+	size = static_cast<std::size_t>(status.st_size);
+	// An empty file cannot be mapped, and has nothing to map anyway
+	if (size > 0) {
+		void* memory = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (memory != MAP_FAILED) {
+			data = static_cast<const std::byte*>(memory);
+			// The file is read front to back
+			madvise(memory, size, MADV_SEQUENTIAL);
+		}
+	}
+	close(file);
+	if (size > 0 && data == nullptr) throw std::runtime_error("cannot map " + path + " into memory");
+}
+
+MappedFile::~MappedFile() {
+	if (data != nullptr) munmap(const_cast<std::byte*>(data), size);
+}
+#endif
@@ -0,0 +1,31 @@
+#ifndef RAYTRACING_MAPPEDFILE_H
+#define RAYTRACING_MAPPEDFILE_H
+#include <cstddef>
+#include <string>
+
+/*
+ * A whole file mapped read-only into memory, with mmap on POSIX systems and a file mapping on Windows. The pages are
+ * only read from disk as they are touched, and the mapping is released when the object is destroyed.
+ */
+class MappedFile {
+	const std::byte* data = nullptr;
+	std::size_t size = 0;
+#ifdef _WIN32
+	void* mapping = nullptr;
+#endif
+
+public:
+	// Map the file, throwing std::runtime_error if it cannot be opened or mapped
+	explicit MappedFile(const std::string& path);
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile();
+
+	[[nodiscard]] const std::byte* getData() const {return data;}
+
+	[[nodiscard]] std::size_t getSize() const {return size;}
+};
+
+#endif //RAYTRACING_MAPPEDFILE_H
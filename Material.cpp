@@ -0,0 +1 @@
+#include "Material.h"
\ No newline at end of file
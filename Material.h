@@ -0,0 +1,81 @@
+#ifndef RAYTRACING_MATERIAL_H
+#define RAYTRACING_MATERIAL_H
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "ColorRGB.h"
+#include "Random.h"
+
+// Surface properties shared by every kind of object, referenced by index from the scene's primitives
+class Material {
+    // The diffuse colour of the object
+    ColorRGB colour;
+
+    // Coefficients for calculating Phong illumination
+    Real phong_kD, phong_kS, phong_alpha;
+
+    // How reflective this object is
+    Real reflectivity;
+
+    // How much light is transmitted through the object (between 0 and 1)
+    ColorRGB transmittance;
+    Real refractive_index;
+
+public:
+    Material() :
+        colour(1),phong_kD(0),phong_kS(0),phong_alpha(0),reflectivity(0),transmittance(0),
+        refractive_index(1.5) {}
+
+    Material(const ColorRGB& colour, Real phong_kD, Real phong_kS, Real phong_alpha, Real reflectivity,
+        Real transmittance) :
+    colour(colour), phong_kD(phong_kD), phong_kS(phong_kS), phong_alpha(phong_alpha), reflectivity(reflectivity),
+    transmittance(transmittance), refractive_index(1.5) {}
+
+    // With a transmittance per colour channel, for tinted transparent objects
+    Material(const ColorRGB& colour, Real phong_kD, Real phong_kS, Real phong_alpha, Real reflectivity,
+        const ColorRGB& transmittance) :
+    colour(colour), phong_kD(phong_kD), phong_kS(phong_kS), phong_alpha(phong_alpha), reflectivity(reflectivity),
+    transmittance(transmittance), refractive_index(1.5) {}
+
+    [[nodiscard]] ColorRGB getColour() const {return colour;}
+
+    void setColour(const ColorRGB& colour) {this->colour = colour;}
+
+    [[nodiscard]] Real getPhong_kD() const {return phong_kD;}
+
+    [[nodiscard]] Real getPhong_kS() const {return phong_kS;}
+
+    [[nodiscard]] Real getPhong_alpha() const {return phong_alpha;}
+
+    [[nodiscard]] Real getReflectivity() const {return reflectivity;}
+
+    void setReflectivity(Real reflectivity) {this->reflectivity = reflectivity;}
+
+    [[nodiscard]] bool isTransmissive() const {return !transmittance.isZero();}
+
+    [[nodiscard]] ColorRGB getTransmittance() const { return transmittance; }
+
+    [[nodiscard]] Real getRefractiveIndex() const {return refractive_index;}
+
+    [[nodiscard]] bool equals(const Material& other) const {
+        return colour.equals(other.colour) && phong_kD == other.phong_kD && phong_kS == other.phong_kS &&
+            phong_alpha == other.phong_alpha && reflectivity == other.reflectivity &&
+            transmittance.equals(other.transmittance) && refractive_index == other.refractive_index;
+    }
+
+    // Hash of the properties, the same for any two materials that are equal
+    [[nodiscard]] std::size_t hash() const {
+        std::uint64_t hash = 0;
+        for (const Real value : {colour.r(), colour.g(), colour.b(), phong_kD, phong_kS, phong_alpha, reflectivity,
+            transmittance.r(), transmittance.g(), transmittance.b(), refractive_index}) {
+            hash = Random::combine(hash, std::hash<Real>{}(value));
+        }
+        return static_cast<std::size_t>(hash);
+    }
+};
+
+// Material reported for rays that hit nothing
+inline const Material NO_MATERIAL;
+
+#endif //RAYTRACING_MATERIAL_H
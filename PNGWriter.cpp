@@ -0,0 +1 @@
+#include "PNGWriter.h"
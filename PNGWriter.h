@@ -0,0 +1,249 @@
+#ifndef RAYTRACING_PNGWRITER_H
+#define RAYTRACING_PNGWRITER_H
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "ImageWriter.h"
+
+/*
+ * PNG compressed with deflate's fixed Huffman codes and a small LZ77 match finder, so no compression library is
+ * needed. Each row takes whichever PNG filter leaves the smallest sum of absolute differences. Every band of rows
+ * becomes one deflate block in its own IDAT chunk, with matches reaching back into the bands before it; the zlib
+ * stream they make up together is only closed off when the image is finished.
+ */
+class PNGWriter final : public ImageWriter {
+	// How far back deflate matches may reach, and how long they may be
+	static constexpr size_t WINDOW = 32768;
+	static constexpr size_t MIN_MATCH = 3, MAX_MATCH = 258;
+	// Earlier positions with the same hash tried for each match, trading speed for compression
+	static constexpr int MAX_PROBES = 16;
+	static constexpr int HASH_BITS = 15;
+
+	static constexpr std::array<std::uint16_t, 29> LENGTH_BASE = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27,
+		31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+	static constexpr std::array<std::uint8_t, 29> LENGTH_EXTRA = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3,
+		3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+	static constexpr std::array<std::uint16_t, 30> DISTANCE_BASE = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97,
+		129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+	static constexpr std::array<std::uint8_t, 30> DISTANCE_EXTRA = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7,
+		7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+	static std::array<std::uint32_t, 256> crcTable() {
+		std::array<std::uint32_t, 256> table{};
+		for (std::uint32_t n = 0; n < 256; ++n) {
+			std::uint32_t c = n;
+			for (int k = 0; k < 8; ++k) {c = c & 1 ? 0xedb88320u ^ c >> 1 : c >> 1;}
+			table[n] = c;
+		}
+		return table;
+	}
+
+	inline static const std::array<std::uint32_t, 256> CRC_TABLE = crcTable();
+
+	static std::uint32_t crc(std::uint32_t crc, const std::uint8_t* data, const size_t size) {
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i) {crc = CRC_TABLE[(crc ^ data[i]) & 0xff] ^ crc >> 8;}
+		return ~crc;
+	}
+
+	// The Paeth predictor: whichever of left, above and upper left is closest to left + above - upper left
+	static int paeth(const int a, const int b, const int c) {
+		const int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+		return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+	}
+
+	// Adler-32 checksum of the uncompressed data, which ends the zlib stream
+	std::uint32_t adlerA = 1, adlerB = 0;
+
+	// The last row as rendered, which the Up, Average and Paeth filters predict from, and a row under each filter
+	std::vector<std::uint8_t> previousRow;
+	std::array<std::vector<std::uint8_t>, 5> filtered;
+
+	// Up to WINDOW bytes of earlier bands followed by this band's filtered rows, and the chunk being built from them
+	std::vector<std::uint8_t> window, chunk;
+	// The latest window position with each hash of three bytes, and for every position the one before it with the
+	// same hash, or -1 if there is none
+	std::vector<std::int32_t> head, chain;
+
+	// Bits that don't yet make up a whole byte of the chunk, the earliest in the lowest bit
+	std::uint32_t bitBuffer = 0;
+	int bitCount = 0;
+
+	void writeChunk(const char type[4], const std::uint8_t* data, const size_t size) {
+		writeBigEndian(static_cast<std::uint32_t>(size));
+		write(type, 4);
+		write(data, size);
+		std::uint32_t checksum = crc(0, reinterpret_cast<const std::uint8_t*>(type), 4);
+		checksum = crc(checksum, data, size);
+		writeBigEndian(checksum);
+	}
+
+	void updateAdler(const std::uint8_t* data, const size_t size) {
+		for (size_t i = 0; i < size; ++i) {
+			adlerA = (adlerA + data[i]) % 65521;
+			adlerB = (adlerB + adlerA) % 65521;
+		}
+	}
+
+	// Append count bits of value to the chunk, lowest bit first as deflate packs everything but Huffman codes
+	void writeBits(const std::uint32_t value, const int count) {
+		bitBuffer |= value << bitCount;
+		bitCount += count;
+		for (; bitCount >= 8; bitCount -= 8, bitBuffer >>= 8) {chunk.push_back(bitBuffer & 0xff);}
+	}
+
+	// Huffman codes are packed highest bit first
+	void writeCode(const std::uint32_t code, const int length) {
+		std::uint32_t reversed = 0;
+		for (int i = 0; i < length; ++i) {reversed = reversed << 1 | (code >> i & 1);}
+		writeBits(reversed, length);
+	}
+
+	// A literal byte, the end of block marker 256, or a length code from 257 up, in the fixed literal/length code
+	void writeSymbol(const int symbol) {
+		if (symbol < 144) writeCode(0x30 + symbol, 8);
+		else if (symbol < 256) writeCode(0x190 + symbol - 144, 9);
+		else if (symbol < 280) writeCode(symbol - 256, 7);
+		else writeCode(0xc0 + symbol - 280, 8);
+	}
+
+	void writeMatch(const size_t length, const size_t distance) {
+		int code = static_cast<int>(LENGTH_BASE.size()) - 1;
+		while (LENGTH_BASE[code] > length) --code;
+		writeSymbol(257 + code);
+		writeBits(static_cast<std::uint32_t>(length - LENGTH_BASE[code]), LENGTH_EXTRA[code]);
+		code = static_cast<int>(DISTANCE_BASE.size()) - 1;
+		while (DISTANCE_BASE[code] > distance) --code;
+		// Distance codes are all five bits long
+		writeCode(code, 5);
+		writeBits(static_cast<std::uint32_t>(distance - DISTANCE_BASE[code]), DISTANCE_EXTRA[code]);
+	}
+
+	// Filter a row with each PNG filter and append the smallest to the window, preceded by its filter type
+	void filterRow(const std::uint8_t* row) {
+		const size_t size = previousRow.size();
+		int best = 0;
+		long bestScore = std::numeric_limits<long>::max();
+		for (int type = 0; type < 5; ++type) {
+			std::vector<std::uint8_t>& out = filtered[type];
+			out.resize(size);
+			long score = 0;
+			for (size_t i = 0; i < size; ++i) {
+				const int a = i >= 3 ? row[i - 3] : 0, b = previousRow[i], c = i >= 3 ? previousRow[i - 3] : 0;
+				const int prediction = type == 0 ? 0 : type == 1 ? a : type == 2 ? b : type == 3 ? (a + b) / 2
+					: paeth(a, b, c);
+				out[i] = static_cast<std::uint8_t>(row[i] - prediction);
+				// Read as signed, so small steps either way both score low
+				score += out[i] < 128 ? out[i] : 256 - out[i];
+			}
+			if (score < bestScore) {
+				bestScore = score;
+				best = type;
+			}
+		}
+		window.push_back(static_cast<std::uint8_t>(best));
+		window.insert(window.end(), filtered[best].begin(), filtered[best].end());
+		previousRow.assign(row, row + size);
+	}
+
+	[[nodiscard]] std::uint32_t hash(const size_t position) const {
+		return (window[position] << 10 ^ window[position + 1] << 5 ^ window[position + 2]) & ((1u << HASH_BITS) - 1);
+	}
+
+	// Make a window position a match candidate, once the three bytes it hashes are all there
+	void insert(const size_t position) {
+		if (position + MIN_MATCH > window.size()) return;
+		const std::uint32_t h = hash(position);
+		chain[position] = head[h];
+		head[h] = static_cast<std::int32_t>(position);
+	}
+
+	// Deflate the window from start on as one non-final block with the fixed codes, then keep only its last WINDOW
+	// bytes for the next band to match against
+	void compress(const size_t start) {
+		// BFINAL clear, BTYPE 01 for the fixed codes
+		writeBits(1 << 1, 3);
+		head.assign(size_t{1} << HASH_BITS, -1);
+		chain.resize(window.size());
+		for (size_t position = 0; position < start; ++position) {insert(position);}
+
+		for (size_t position = start; position < window.size();) {
+			const size_t limit = std::min(MAX_MATCH, window.size() - position);
+			size_t bestLength = 0, bestDistance = 0;
+			if (limit >= MIN_MATCH) {
+				int probes = MAX_PROBES;
+				for (std::int32_t candidate = head[hash(position)];
+					candidate >= 0 && position - candidate <= WINDOW && probes-- > 0; candidate = chain[candidate]) {
+					size_t length = 0;
+					while (length < limit && window[candidate + length] == window[position + length]) ++length;
+					if (length > bestLength) {
+						bestLength = length;
+						bestDistance = position - candidate;
+						if (length == limit) break;
+					}
+				}
+			}
+			if (bestLength >= MIN_MATCH) {
+				writeMatch(bestLength, bestDistance);
+				for (size_t i = 0; i < bestLength; ++i) {insert(position + i);}
+				position += bestLength;
+			} else {
+				writeSymbol(window[position]);
+				insert(position);
+				++position;
+			}
+		}
+		writeSymbol(256);
+
+		if (window.size() > WINDOW) window.erase(window.begin(), window.end() - WINDOW);
+	}
+
+public:
+	explicit PNGWriter(const std::string& path) : ImageWriter(path) {}
+
+	void begin(const int width, const int height) override {
+		ImageWriter::begin(width, height);
+		static constexpr std::uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+		write(signature, 8);
+		// 8 bit RGB, no interlacing
+		std::vector<std::uint8_t> header;
+		for (const int value : {width, height}) {
+			for (int shift = 24; shift >= 0; shift -= 8) {header.push_back(value >> shift & 0xff);}
+		}
+		header.insert(header.end(), {8, 2, 0, 0, 0});
+		writeChunk("IHDR", header.data(), header.size());
+
+		// The row above the first counts as all zero
+		previousRow.assign(3 * static_cast<size_t>(width), 0);
+		// The zlib header, for deflate with a 32K window and no preset dictionary
+		chunk = {0x78, 0x01};
+	}
+
+	void writeRows(const std::uint8_t* pixels, const int rows, const int pitch) override {
+		const size_t start = window.size();
+		for (int y = 0; y < rows; ++y) {filterRow(pixels + static_cast<size_t>(y) * pitch);}
+		updateAdler(window.data() + start, window.size() - start);
+		compress(start);
+		// Whatever bits don't fill a byte are carried over to the next chunk
+		writeChunk("IDAT", chunk.data(), chunk.size());
+		chunk.clear();
+	}
+
+	void finish() override {
+		// An empty final block closes the deflate stream, padded out to a whole byte and followed by the checksum
+		writeBits(1 | 1 << 1, 3);
+		writeSymbol(256);
+		if (bitCount > 0) writeBits(0, 8 - bitCount);
+		const std::uint32_t adler = adlerB << 16 | adlerA;
+		for (int shift = 24; shift >= 0; shift -= 8) {chunk.push_back(adler >> shift & 0xff);}
+		writeChunk("IDAT", chunk.data(), chunk.size());
+		writeChunk("IEND", nullptr, 0);
+		ImageWriter::finish();
+	}
+};
+
+#endif //RAYTRACING_PNGWRITER_H
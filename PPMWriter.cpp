@@ -0,0 +1 @@
+#include "PPMWriter.h"
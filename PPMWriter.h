@@ -0,0 +1,23 @@
+#ifndef RAYTRACING_PPMWRITER_H
+#define RAYTRACING_PPMWRITER_H
+#include <string>
+
+#include "ImageWriter.h"
+
+// Binary portable pixmap (P6), which is just a short header followed by the raw rows
+class PPMWriter final : public ImageWriter {
+public:
+	explicit PPMWriter(const std::string& path) : ImageWriter(path) {}
+
+	void begin(const int width, const int height) override {
+		ImageWriter::begin(width, height);
+		const std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+		write(header.data(), header.size());
+	}
+
+	void writeRows(const std::uint8_t* pixels, const int rows, const int pitch) override {
+		for (int y = 0; y < rows; ++y) {write(pixels + static_cast<size_t>(y) * pitch, 3 * static_cast<size_t>(width));}
+	}
+};
+
+#endif //RAYTRACING_PPMWRITER_H
@@ -4,52 +4,76 @@
 
 #ifndef RAYTRACING_PLANE_H
 #define RAYTRACING_PLANE_H
-#include <functional>
+#include <cstdint>
 
-#include "RaycastHit.h"
 #include "SceneObject.h"
 //Plane Defaults
-static double DEFAULT_PLANE_KD = 0.6;
-static double DEFAULT_PLANE_KS = 0.0;
-static double DEFAULT_PLANE_ALPHA = 0.0;
-static double DEFAULT_PLANE_REFLECTIVITY = 0.1;
-
-class Plane : public SceneObject {
+static Real DEFAULT_PLANE_KD = 0.6;
+static Real DEFAULT_PLANE_KS = 0.0;
+static Real DEFAULT_PLANE_ALPHA = 0.0;
+static Real DEFAULT_PLANE_REFLECTIVITY = 0.1;
 
+// Compact plane geometry stored contiguously by the scene, with its material referenced by index
+struct PlanePrimitive {
     // A point in the plane
     Vector3 point;
-    // The normal of the plane
+    // The normal of the plane, unit length after precompute()
     Vector3 normal;
+    std::uint32_t material;
+    // Signed distance of the plane from the origin along the normal, set by precompute()
+    Real offset = 0;
 
-public:
-    Plane(const Vector3 &point, const Vector3 &normal, const ColorRGB &colour) :
-    SceneObject(colour, DEFAULT_PLANE_KD, DEFAULT_PLANE_KS, DEFAULT_PLANE_ALPHA, DEFAULT_PLANE_REFLECTIVITY),
-    point(point), normal(normal) {}
-
-    Plane(const Vector3 &point, const Vector3 &normal, const ColorRGB &colour, double kD, double kS, double alphaS, double reflectivity) :
-        point(point), normal(normal), SceneObject(colour, kD, kS, alphaS, reflectivity) {}
+    // Normalise the normal and fill in the plane offset, which every query relies on
+    void precompute() {
+        normal = normal.normalised();
+        offset = point.dot(normal);
+    }
 
-    // Intersect this plane with a ray
-    RaycastHit* intersectionWith(const Ray ray) override {
+    // Calculate the distance along the ray to this plane, or infinity if it is missed
+    [[nodiscard]] Real intersectDistance(const Ray& ray) const {
         // Get ray parameters
         const Vector3 O = ray.getOrigin();
         const Vector3 D = ray.getDirection();
 
         // Get plane parameters
-        const Vector3 Q = this->point;
         const Vector3 N = this->normal;
-        if (const double scaling = D.dot(N); scaling == 0) {return new RaycastHit();}
+        if (const Real scaling = D.dot(N); scaling == 0) {return NO_INTERSECTION;}
         else {
-            if (const double s = Q.subtract(O).dot(N) / scaling; s < 0) {return new RaycastHit();}
-            else {
-                const Vector3 loc = ray.evaluateAt(s);
-                return new RaycastHit(*this, s, loc, N);
-            }
+            if (const Real s = (offset - O.dot(N)) / scaling; s < 0) {return NO_INTERSECTION;}
+            else {return s;}
         }
     }
 
+    // Get the unit normal to the plane
+    [[nodiscard]] Vector3 getNormalAt(const Vector3& location) const {return normal;}
+};
+
+class Plane final : public SceneObject {
+
+    // A point in the plane
+    Vector3 point;
+    // The normal of the plane
+    Vector3 normal;
+
+public:
+    Plane(const Vector3 &point, const Vector3 &normal, const ColorRGB &colour) :
+    SceneObject(colour, DEFAULT_PLANE_KD, DEFAULT_PLANE_KS, DEFAULT_PLANE_ALPHA, DEFAULT_PLANE_REFLECTIVITY),
+    point(point), normal(normal) {}
+
+    Plane(const Vector3 &point, const Vector3 &normal, const ColorRGB &colour, Real kD, Real kS, Real alphaS, Real reflectivity) :
+        SceneObject(colour, kD, kS, alphaS, reflectivity), point(point), normal(normal) {}
+
+    // The geometry of this plane, using the given material index
+    [[nodiscard]] PlanePrimitive toPrimitive(const std::uint32_t material) const {
+        PlanePrimitive primitive = {point, normal, material};
+        primitive.precompute();
+        return primitive;
+    }
+
+    [[nodiscard]] Real intersectDistance(const Ray& ray) const override {return toPrimitive(0).intersectDistance(ray);}
+
     // Get normal to the plane
-    Vector3 getNormalAt(Vector3 position) override {return normal;}
+    [[nodiscard]] Vector3 getNormalAt(const Vector3& position) const override {return normal;}
 };
 
 #endif //RAYTRACING_PLANE_H
\ No newline at end of file
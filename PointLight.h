@@ -6,30 +6,55 @@
 #define RAYTRACING_POINTLIGHT_H
 #include "ColorRGB.h"
 #include "Vector3.h"
+#include <algorithm>
 #include <cmath>
+#include <limits>
 
 
+// Compact light data built when the scene is committed, with the inverse square falloff constant folded in
+struct LightPrimitive {
+    Vector3 position;
+    ColorRGB colour;
+    // colour * intensity / 4 pi, so the illumination at distance d is just this over d squared
+    ColorRGB radiantIntensity;
+
+    [[nodiscard]] ColorRGB getIlluminationAt(const Real distance) const {
+        return radiantIntensity.scale(1 / (distance * distance));
+    }
+
+    // Distance at which the brightest channel of the illumination falls to the threshold, beyond which the light is
+    // treated as contributing nothing. A threshold of 0 never cuts the light off.
+    [[nodiscard]] Real getInfluenceRadius(const Real threshold) const {
+        if (threshold <= 0) return std::numeric_limits<Real>::infinity();
+        return std::sqrt(std::max({radiantIntensity.r(), radiantIntensity.g(), radiantIntensity.b()}) / threshold);
+    }
+};
+
 class PointLight {
 
     // Point light parameters
     Vector3 position;
     ColorRGB colour;
-    double intensity;
+    Real intensity;
 
 public:
-    PointLight(const Vector3 &position, const ColorRGB &colour, const double intensity) : position(position),
+    PointLight(const Vector3 &position, const ColorRGB &colour, const Real intensity) : position(position),
     colour(colour), intensity(intensity) {}
 
     [[nodiscard]] Vector3 getPosition() const {return position;}
 
     [[nodiscard]] ColorRGB getColour() const {return colour;}
 
-    [[nodiscard]] double getIntensity() const {return intensity;}
+    [[nodiscard]] Real getIntensity() const {return intensity;}
 
     // Get colour of light at a certain distance away
-    [[nodiscard]] ColorRGB getIlluminationAt(const double distance) const {
+    [[nodiscard]] ColorRGB getIlluminationAt(const Real distance) const {
     return colour.scale(intensity / (M_PI * 4 * pow(distance, 2)));
     }
+
+    [[nodiscard]] LightPrimitive toPrimitive() const {
+        return {position, colour, colour.scale(intensity / static_cast<Real>(M_PI * 4))};
+    }
 };
 
 #endif //RAYTRACING_POINTLIGHT_H
\ No newline at end of file
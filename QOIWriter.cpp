@@ -0,0 +1 @@
+#include "QOIWriter.h"
@@ -0,0 +1,100 @@
+#ifndef RAYTRACING_QOIWRITER_H
+#define RAYTRACING_QOIWRITER_H
+#include <array>
+#include <string>
+#include <vector>
+
+#include "ImageWriter.h"
+
+/*
+ * The Quite OK Image format. The encoder state is a running pixel, a run length and a 64 entry index of recently
+ * seen pixels, so rows can be encoded as they arrive.
+ */
+class QOIWriter final : public ImageWriter {
+	struct Pixel {
+		std::uint8_t r = 0, g = 0, b = 0, a = 255;
+
+		bool operator==(const Pixel&) const = default;
+
+		[[nodiscard]] int hash() const {return (r * 3 + g * 5 + b * 7 + a * 11) % 64;}
+	};
+
+	static constexpr std::uint8_t OP_INDEX = 0x00, OP_DIFF = 0x40, OP_LUMA = 0x80, OP_RUN = 0xc0, OP_RGB = 0xfe;
+
+	std::array<Pixel, 64> index;
+	Pixel previous;
+	int run = 0;
+
+	// Encoded bytes of the current band, written out in one go
+	std::vector<std::uint8_t> buffer;
+
+	void flushRun() {
+		if (run == 0) return;
+		buffer.push_back(OP_RUN | (run - 1));
+		run = 0;
+	}
+
+	void encode(const Pixel& pixel) {
+		if (pixel == previous) {
+			// Runs are limited to 62 so they don't collide with the RGB and RGBA tags
+			if (++run == 62) flushRun();
+			return;
+		}
+		flushRun();
+
+		const int hash = pixel.hash();
+		if (index[hash] == pixel) {
+			buffer.push_back(OP_INDEX | hash);
+		} else {
+			index[hash] = pixel;
+			// Alpha is always opaque, so only the RGB operations are ever needed
+			const auto dr = static_cast<std::int8_t>(pixel.r - previous.r);
+			const auto dg = static_cast<std::int8_t>(pixel.g - previous.g);
+			const auto db = static_cast<std::int8_t>(pixel.b - previous.b);
+			const int drdg = dr - dg, dbdg = db - dg;
+			if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+				buffer.push_back(OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+			} else if (dg >= -32 && dg <= 31 && drdg >= -8 && drdg <= 7 && dbdg >= -8 && dbdg <= 7) {
+				buffer.push_back(OP_LUMA | (dg + 32));
+				buffer.push_back((drdg + 8) << 4 | (dbdg + 8));
+			} else {
+				buffer.insert(buffer.end(), {OP_RGB, pixel.r, pixel.g, pixel.b});
+			}
+		}
+		previous = pixel;
+	}
+
+public:
+	// The decoder starts with every index entry zeroed, including alpha
+	explicit QOIWriter(const std::string& path) : ImageWriter(path) {index.fill({0, 0, 0, 0});}
+
+	void begin(const int width, const int height) override {
+		ImageWriter::begin(width, height);
+		write("qoif", 4);
+		writeBigEndian(width);
+		writeBigEndian(height);
+		// 3 channels, sRGB with linear alpha
+		writeByte(3);
+		writeByte(0);
+	}
+
+	void writeRows(const std::uint8_t* pixels, const int rows, const int pitch) override {
+		buffer.clear();
+		for (int y = 0; y < rows; ++y) {
+			const std::uint8_t* row = pixels + static_cast<size_t>(y) * pitch;
+			for (int x = 0; x < width; ++x) {encode({row[3 * x], row[3 * x + 1], row[3 * x + 2]});}
+		}
+		write(buffer.data(), buffer.size());
+	}
+
+	void finish() override {
+		buffer.clear();
+		flushRun();
+		// End marker
+		buffer.insert(buffer.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+		write(buffer.data(), buffer.size());
+		ImageWriter::finish();
+	}
+};
+
+#endif //RAYTRACING_QOIWRITER_H
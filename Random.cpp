@@ -0,0 +1 @@
+#include "Random.h"
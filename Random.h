@@ -0,0 +1,38 @@
+#ifndef RAYTRACING_RANDOM_H
+#define RAYTRACING_RANDOM_H
+#include <bit>
+#include <cstdint>
+#include <type_traits>
+
+#include "Real.h"
+#include "Vector3.h"
+
+/*
+ * Stateless random numbers derived by hashing, so a sample is a pure function of where and when it is taken. That
+ * keeps renders reproducible whatever thread a tile lands on, with no generator state to pass around.
+ */
+namespace Random {
+	// The SplitMix64 finaliser, which spreads every input bit across the whole output
+	constexpr std::uint64_t mix(std::uint64_t x) {
+		x += 0x9e3779b97f4a7c15ull;
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+		return x ^ (x >> 31);
+	}
+
+	constexpr std::uint64_t combine(const std::uint64_t seed, const std::uint64_t value) {return mix(seed ^ mix(value));}
+
+	inline std::uint64_t hash(const Vector3& point) {
+		using Bits = std::conditional_t<sizeof(Real) == 8, std::uint64_t, std::uint32_t>;
+		const auto bits = [](const Real value) {return static_cast<std::uint64_t>(std::bit_cast<Bits>(value));};
+		return combine(combine(mix(bits(point.x)), bits(point.y)), bits(point.z));
+	}
+
+	// A uniform value in [0, 1) from the top bits of a hash
+	inline Real toUnit(const std::uint64_t hash) {
+		constexpr int BITS = sizeof(Real) == 8 ? 53 : 24;
+		return static_cast<Real>(hash >> (64 - BITS)) * (static_cast<Real>(1) / static_cast<Real>(1ull << BITS));
+	}
+}
+
+#endif //RAYTRACING_RANDOM_H
@@ -4,26 +4,45 @@
 
 #ifndef RAYTRACING_RAY_H
 #define RAYTRACING_RAY_H
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #include "Vector3.h"
 
 
-class Ray {
+// Ray over a scalar type T, use the Ray alias for the build's precision
+template <typename T>
+class RayT {
 
     // Ray parameters
 
 private:
-    Vector3 origin, direction;
+    Vector3T<T> origin, direction;
 
 public:
-    Ray(const Vector3 &origin, const Vector3 &direction):origin(origin), direction(direction) {}
+    RayT(const Vector3T<T> &origin, const Vector3T<T> &direction):origin(origin), direction(direction) {}
 
-    [[nodiscard]] Vector3 getOrigin() const {return origin;}
+    [[nodiscard]] Vector3T<T> getOrigin() const {return origin;}
 
-    [[nodiscard]] Vector3 getDirection() const {return direction;}
+    [[nodiscard]] Vector3T<T> getDirection() const {return direction;}
 
     // Determine position for certain scalar parameter distance i.e. (origin + direction * distance)
-    [[nodiscard]] Vector3 evaluateAt(const double distance) const {return origin.add(direction.scale(distance));}
+    [[nodiscard]] Vector3T<T> evaluateAt(const T distance) const {return origin.add(direction.scale(distance));}
+
+    /*
+     * Move a point on a surface off it along the unit normal N, far enough that a ray leaving from it cannot hit the
+     * same surface again through rounding error. The error of a hit point is a few units in the last place of its
+     * largest coordinate, so the offset is a multiple of the machine epsilon of T scaled by that magnitude, never
+     * less than at magnitude one so points near the origin still move.
+     */
+    static Vector3T<T> offsetOrigin(const Vector3T<T>& P, const Vector3T<T>& N) {
+        constexpr T SCALE = 16 * std::numeric_limits<T>::epsilon();
+        const T magnitude = std::max({static_cast<T>(1), std::abs(P.x), std::abs(P.y), std::abs(P.z)});
+        return P.add(N.scale(SCALE * magnitude));
+    }
 };
 
+using Ray = RayT<Real>;
 
 #endif //RAYTRACING_RAY_H
\ No newline at end of file
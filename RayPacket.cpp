@@ -0,0 +1 @@
+#include "RayPacket.h"
\ No newline at end of file
@@ -0,0 +1,142 @@
+#ifndef RAYTRACING_RAYPACKET_H
+#define RAYTRACING_RAYPACKET_H
+#include <array>
+#include <cstring>
+
+#include "AABB.h"
+#include "Ray.h"
+#include "Vector3.h"
+
+/*
+ * A 2x2 block of coherent rays sharing an origin, such as the primary rays of neighbouring pixels. The packet
+ * traverses the BVH as a whole; lanes outside the active mask are ignored. Per-lane values are kept in 16 byte GCC
+ * vectors, the width SSE2 gives every x86-64 CPU, so that testing every lane against a box or a plane takes one vector
+ * of instructions in single precision and two in double precision. There is no frustum test: with the slab test this
+ * cheap, culling boxes against the packet's bounding planes first cost more than it saved on every benchmark scene.
+ */
+class RayPacket {
+public:
+	static constexpr int SIZE = 4;
+
+	// Mask with every lane active
+	static constexpr unsigned ALL_LANES = (1u << SIZE) - 1;
+
+private:
+	using Vector = Real __attribute__((vector_size(16)));
+	static constexpr int VECTOR_LANES = 16 / sizeof(Real);
+	static constexpr int VECTORS = SIZE / VECTOR_LANES;
+	using Lanes = std::array<Vector, VECTORS>;
+
+	Vector3 origin;
+
+	// Directions and inverse directions, one component per vector
+	Lanes dx, dy, dz;
+	Lanes invDx, invDy, invDz;
+
+	// Sum of the directions
+	Vector3 direction;
+
+	unsigned active;
+
+	static Vector load(const Real* values) {
+		Vector vector;
+		std::memcpy(&vector, values, sizeof(vector));
+		return vector;
+	}
+
+	static void store(Real* values, const Vector vector) {std::memcpy(values, &vector, sizeof(vector));}
+
+	// Lane-wise minimum and maximum, picking the same operand as std::min and std::max do
+	static Vector min(const Vector a, const Vector b) {return b < a ? b : a;}
+	static Vector max(const Vector a, const Vector b) {return a < b ? b : a;}
+
+	// The packet's lane bits for a comparison's result on one of its vectors, set where it held
+	template <typename Mask>
+	static unsigned bits(const Mask mask, const int vector) {
+		unsigned result = 0;
+		for (int lane = 0; lane < VECTOR_LANES; ++lane) {result |= (mask[lane] != 0 ? 1u : 0u) << lane;}
+		return result << vector * VECTOR_LANES;
+	}
+
+	static Vector dot(const Vector3& normal, const Vector x, const Vector y, const Vector z) {
+		return normal.x * x + normal.y * y + normal.z * z;
+	}
+
+public:
+	/*
+	 * Build a packet from rays sharing an origin, in any order. Inactive lanes must still hold a ray with the shared
+	 * origin, such as a copy of an active lane.
+	 */
+	RayPacket(const std::array<Ray, SIZE>& rays, const unsigned active) : origin(rays[0].getOrigin()), direction(0),
+		active(active) {
+		std::array<Real, SIZE> x{}, y{}, z{};
+		for (int lane = 0; lane < SIZE; ++lane) {
+			const Vector3 D = rays[lane].getDirection();
+			x[lane] = D.x;
+			y[lane] = D.y;
+			z[lane] = D.z;
+			direction = direction.add(D);
+		}
+		for (int vector = 0; vector < VECTORS; ++vector) {
+			dx[vector] = load(&x[vector * VECTOR_LANES]);
+			dy[vector] = load(&y[vector * VECTOR_LANES]);
+			dz[vector] = load(&z[vector * VECTOR_LANES]);
+			invDx[vector] = 1 / dx[vector];
+			invDy[vector] = 1 / dy[vector];
+			invDz[vector] = 1 / dz[vector];
+		}
+	}
+
+public:
+	[[nodiscard]] unsigned getActive() const {return active;}
+
+	[[nodiscard]] Vector3 getOrigin() const {return origin;}
+
+	[[nodiscard]] Ray getRay(const int lane) const {
+		const int vector = lane / VECTOR_LANES, element = lane % VECTOR_LANES;
+		return {origin, Vector3(dx[vector][element], dy[vector][element], dz[vector][element])};
+	}
+
+	// Sum of the lanes' directions, pointing into the middle of the packet
+	[[nodiscard]] Vector3 getDirection() const {return direction;}
+
+	// Slab test of every lane against the box, returning the mask of the given lanes that reach it before their tMax
+	[[nodiscard]] unsigned intersectBox(const AABB& box, const std::array<Real, SIZE>& tMax, const unsigned lanes) const {
+		const Real minX = box.min.x - origin.x, maxX = box.max.x - origin.x;
+		const Real minY = box.min.y - origin.y, maxY = box.max.y - origin.y;
+		const Real minZ = box.min.z - origin.z, maxZ = box.max.z - origin.z;
+		unsigned mask = 0;
+		for (int vector = 0; vector < VECTORS; ++vector) {
+			const Vector tx1 = minX * invDx[vector], tx2 = maxX * invDx[vector];
+			const Vector ty1 = minY * invDy[vector], ty2 = maxY * invDy[vector];
+			const Vector tz1 = minZ * invDz[vector], tz2 = maxZ * invDz[vector];
+			const Vector limit = load(&tMax[vector * VECTOR_LANES]);
+			const Vector tNear = max(max(min(tx1, tx2), min(ty1, ty2)), max(min(tz1, tz2), Vector{}));
+			const Vector tFar = min(min(max(tx1, tx2), max(ty1, ty2)), min(max(tz1, tz2), limit));
+			mask |= bits(tNear <= tFar, vector);
+		}
+		return mask & lanes;
+	}
+
+	/*
+	 * Intersect every lane with the plane of the given unit normal and offset, as PlanePrimitive::intersectDistance
+	 * does. Every lane that hits the plane before its tMax has tMax shortened to the hit, and the mask of the given
+	 * lanes among them is returned.
+	 */
+	unsigned intersectPlane(const Vector3& normal, const Real offset, std::array<Real, SIZE>& tMax,
+		const unsigned lanes) const {
+		const Real numerator = offset - origin.dot(normal);
+		unsigned mask = 0;
+		for (int vector = 0; vector < VECTORS; ++vector) {
+			const Vector scaling = dot(normal, dx[vector], dy[vector], dz[vector]);
+			const Vector distance = numerator / scaling;
+			const Vector limit = load(&tMax[vector * VECTOR_LANES]);
+			const auto hit = scaling != 0 && distance >= 0 && distance < limit;
+			store(&tMax[vector * VECTOR_LANES], hit ? distance : limit);
+			mask |= bits(hit, vector);
+		}
+		return mask & lanes;
+	}
+};
+
+#endif //RAYTRACING_RAYPACKET_H
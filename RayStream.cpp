@@ -0,0 +1 @@
+#include "RayStream.h"
\ No newline at end of file
@@ -0,0 +1,80 @@
+#ifndef RAYTRACING_RAYSTREAM_H
+#define RAYTRACING_RAYSTREAM_H
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "Ray.h"
+
+// Helpers for tracing large batches of rays, ordering them so that neighbouring rays are coherent
+class RayStream {
+	// Each sort key holds the ray's direction key above its index in the batch
+	static constexpr int INDEX_BITS = 31;
+	static constexpr int KEY_BITS = 33;
+
+	// Bits of the direction key sorted on per radix pass
+	static constexpr int DIGIT_BITS = 11;
+
+	// Spread the low 10 bits of v out so there are two zero bits between each of them
+	static std::uint64_t spreadBits(std::uint64_t v) {
+		v &= 0x3ff;
+		v = (v | v << 16) & 0x30000ff;
+		v = (v | v << 8) & 0x300f00f;
+		v = (v | v << 4) & 0x30c30c3;
+		v = (v | v << 2) & 0x9249249;
+		return v;
+	}
+
+public:
+	// Buffers coherentOrder sorts in, kept by the caller so that ordering batch after batch allocates nothing once
+	// they have grown to the largest batch
+	struct Scratch {
+		std::vector<std::uint64_t> keys, sorted;
+		std::vector<std::uint32_t> order;
+	};
+
+	/*
+	 * Sort key for a ray direction: the octant in the top bits, so rays in different octants never share a run,
+	 * then a Morton code of the quantised direction so similar directions end up next to each other.
+	 */
+	static std::uint64_t directionKey(const Vector3& direction) {
+		const Vector3 D = direction.normalised();
+		const std::uint64_t octant = (D.x < 0 ? 4u : 0u) | (D.y < 0 ? 2u : 0u) | (D.z < 0 ? 1u : 0u);
+		auto quantise = [](const Real c) {return static_cast<std::uint64_t>((c + 1) * 511.5);};
+		return octant << 30 | spreadBits(quantise(D.x)) << 2 | spreadBits(quantise(D.y)) << 1 | spreadBits(quantise(D.z));
+	}
+
+	/*
+	 * Order in which to trace the rays so that rays with similar directions are traced one after another, with rays
+	 * of equal keys kept in batch order. The order is written to the scratch buffers and stays valid until they are
+	 * next used.
+	 */
+	static std::span<const std::uint32_t> coherentOrder(const std::span<const Ray> rays, Scratch& scratch) {
+		assert(rays.size() <= std::uint64_t(1) << INDEX_BITS);
+		std::vector<std::uint64_t>& keys = scratch.keys;
+		keys.resize(rays.size());
+		scratch.sorted.resize(rays.size());
+		for (std::uint32_t i = 0; i < rays.size(); ++i) {keys[i] = directionKey(rays[i].getDirection()) << INDEX_BITS | i;}
+
+		// Least significant digit first radix sort on the direction keys, stable so indices stay in order
+		for (int shift = INDEX_BITS; shift < INDEX_BITS + KEY_BITS; shift += DIGIT_BITS) {
+			std::array<std::uint32_t, 1u << DIGIT_BITS> starts{};
+			for (const std::uint64_t key : keys) {starts[key >> shift & (starts.size() - 1)]++;}
+			std::uint32_t start = 0;
+			for (std::uint32_t& count : starts) {start += std::exchange(count, start);}
+			for (const std::uint64_t key : keys) {scratch.sorted[starts[key >> shift & (starts.size() - 1)]++] = key;}
+			keys.swap(scratch.sorted);
+		}
+
+		scratch.order.resize(rays.size());
+		for (size_t i = 0; i < keys.size(); ++i) {
+			scratch.order[i] = static_cast<std::uint32_t>(keys[i] & ((std::uint64_t(1) << INDEX_BITS) - 1));
+		}
+		return scratch.order;
+	}
+};
+
+#endif //RAYTRACING_RAYSTREAM_H
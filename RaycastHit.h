@@ -7,39 +7,41 @@
 #include "Vector3.h"
 #include <limits>
 
-#include "NullObject.h"
-#include "SceneObject.h"
-static auto NO_COLLISION_VEC = Vector3(std::numeric_limits<double>::infinity(),
-    std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity());
+#include "Material.h"
+static auto NO_COLLISION_VEC = Vector3(std::numeric_limits<Real>::infinity(),
+    std::numeric_limits<Real>::infinity(), std::numeric_limits<Real>::infinity());
+// Value type describing where a ray hit the scene, cheap to copy and never heap allocated
 class RaycastHit {
 
     // The distance the ray travelled before hitting an object
 private:
-    double distance;
+    Real distance;
 
-    // The object that was hit by the ray
-    const SceneObject objectHit;
+    // The material of the object that was hit by the ray, owned by the scene
+    const Material* material;
 
     // The location that the ray hit the object
-    const Vector3 location;
+    Vector3 location;
 
     // The normal of the object at the location hit by the ray
-    const Vector3 normal;
+    Vector3 normal;
 
 public:
-    RaycastHit() : distance(std::numeric_limits<double>::infinity()), objectHit(static_cast<SceneObject>(NullObject())),
+    RaycastHit() : distance(std::numeric_limits<Real>::infinity()), material(&NO_MATERIAL),
     location(NO_COLLISION_VEC), normal(NO_COLLISION_VEC) {}
 
-    RaycastHit(const SceneObject& objectHit, const double distance, const Vector3& location, const Vector3& normal) :
-        distance(distance),objectHit(objectHit),location(location),normal(normal) {}
+    RaycastHit(const Material& material, const Real distance, const Vector3& location, const Vector3& normal) :
+        distance(distance),material(&material),location(location),normal(normal) {}
 
-    [[nodiscard]] SceneObject getObjectHit() const {return objectHit;}
+    [[nodiscard]] const Material& getMaterial() const {return *material;}
 
     [[nodiscard]] Vector3 getLocation() const {return location;}
 
     [[nodiscard]] Vector3 getNormal() const {return  normal;}
 
-    [[nodiscard]] double getDistance() const {return distance;}
+    [[nodiscard]] Real getDistance() const {return distance;}
+
+    [[nodiscard]] bool isHit() const {return distance != std::numeric_limits<Real>::infinity();}
 };
 
 
@@ -0,0 +1 @@
+#include "Real.h"
@@ -0,0 +1,14 @@
+#ifndef RAYTRACING_REAL_H
+#define RAYTRACING_REAL_H
+
+/*
+ * Scalar type for geometry and shading. Rendering is in double precision unless the build defines RAYTRACING_FLOAT,
+ * which halves the size of every vector, ray and scene structure and doubles the lanes per SIMD instruction.
+ */
+#ifdef RAYTRACING_FLOAT
+using Real = float;
+#else
+using Real = double;
+#endif
+
+#endif //RAYTRACING_REAL_H
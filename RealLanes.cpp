@@ -0,0 +1 @@
+#include "RealLanes.h"
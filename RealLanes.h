@@ -0,0 +1,71 @@
+#ifndef RAYTRACING_REALLANES_H
+#define RAYTRACING_REALLANES_H
+
+#include "Real.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RAYTRACING_X86_LANES 1
+#include <immintrin.h>
+
+/*
+ * A 256-bit AVX2 register of Reals, 4 doubles or 8 floats depending on the build precision, so a kernel can be
+ * written once for both. Everything here is force-inlined and can only be called from functions that are themselves
+ * compiled for AVX2, which the caller checks for at runtime. Comparisons give masks with every bit of a lane set where
+ * they hold, which select and bits read.
+ */
+#define RAYTRACING_AVX2_INLINE __attribute__((target("avx2"), always_inline)) inline
+
+namespace RealLanes {
+#ifdef RAYTRACING_FLOAT
+	using Lanes = __m256;
+	constexpr int WIDTH = 8;
+
+	RAYTRACING_AVX2_INLINE Lanes set1(const Real value) {return _mm256_set1_ps(value);}
+	RAYTRACING_AVX2_INLINE Lanes load(const Real* data) {return _mm256_loadu_ps(data);}
+	RAYTRACING_AVX2_INLINE void store(Real* data, const Lanes value) {_mm256_storeu_ps(data, value);}
+	RAYTRACING_AVX2_INLINE Lanes add(const Lanes a, const Lanes b) {return _mm256_add_ps(a, b);}
+	RAYTRACING_AVX2_INLINE Lanes sub(const Lanes a, const Lanes b) {return _mm256_sub_ps(a, b);}
+	RAYTRACING_AVX2_INLINE Lanes mul(const Lanes a, const Lanes b) {return _mm256_mul_ps(a, b);}
+	RAYTRACING_AVX2_INLINE Lanes div(const Lanes a, const Lanes b) {return _mm256_div_ps(a, b);}
+	RAYTRACING_AVX2_INLINE Lanes sqrt(const Lanes a) {return _mm256_sqrt_ps(a);}
+	RAYTRACING_AVX2_INLINE Lanes max(const Lanes a, const Lanes b) {return _mm256_max_ps(a, b);}
+	RAYTRACING_AVX2_INLINE Lanes less(const Lanes a, const Lanes b) {return _mm256_cmp_ps(a, b, _CMP_LT_OQ);}
+	RAYTRACING_AVX2_INLINE Lanes greater(const Lanes a, const Lanes b) {return _mm256_cmp_ps(a, b, _CMP_GT_OQ);}
+	RAYTRACING_AVX2_INLINE Lanes greaterEqual(const Lanes a, const Lanes b) {return _mm256_cmp_ps(a, b, _CMP_GE_OQ);}
+	RAYTRACING_AVX2_INLINE Lanes both(const Lanes a, const Lanes b) {return _mm256_and_ps(a, b);}
+	RAYTRACING_AVX2_INLINE Lanes select(const Lanes mask, const Lanes set, const Lanes clear) {
+		return _mm256_blendv_ps(clear, set, mask);
+	}
+	RAYTRACING_AVX2_INLINE int bits(const Lanes mask) {return _mm256_movemask_ps(mask);}
+#else
+	using Lanes = __m256d;
+	constexpr int WIDTH = 4;
+
+	RAYTRACING_AVX2_INLINE Lanes set1(const Real value) {return _mm256_set1_pd(value);}
+	RAYTRACING_AVX2_INLINE Lanes load(const Real* data) {return _mm256_loadu_pd(data);}
+	RAYTRACING_AVX2_INLINE void store(Real* data, const Lanes value) {_mm256_storeu_pd(data, value);}
+	RAYTRACING_AVX2_INLINE Lanes add(const Lanes a, const Lanes b) {return _mm256_add_pd(a, b);}
+	RAYTRACING_AVX2_INLINE Lanes sub(const Lanes a, const Lanes b) {return _mm256_sub_pd(a, b);}
+	RAYTRACING_AVX2_INLINE Lanes mul(const Lanes a, const Lanes b) {return _mm256_mul_pd(a, b);}
+	RAYTRACING_AVX2_INLINE Lanes div(const Lanes a, const Lanes b) {return _mm256_div_pd(a, b);}
+	RAYTRACING_AVX2_INLINE Lanes sqrt(const Lanes a) {return _mm256_sqrt_pd(a);}
+	RAYTRACING_AVX2_INLINE Lanes max(const Lanes a, const Lanes b) {return _mm256_max_pd(a, b);}
+	RAYTRACING_AVX2_INLINE Lanes less(const Lanes a, const Lanes b) {return _mm256_cmp_pd(a, b, _CMP_LT_OQ);}
+	RAYTRACING_AVX2_INLINE Lanes greater(const Lanes a, const Lanes b) {return _mm256_cmp_pd(a, b, _CMP_GT_OQ);}
+	RAYTRACING_AVX2_INLINE Lanes greaterEqual(const Lanes a, const Lanes b) {return _mm256_cmp_pd(a, b, _CMP_GE_OQ);}
+	RAYTRACING_AVX2_INLINE Lanes both(const Lanes a, const Lanes b) {return _mm256_and_pd(a, b);}
+	RAYTRACING_AVX2_INLINE Lanes select(const Lanes mask, const Lanes set, const Lanes clear) {
+		return _mm256_blendv_pd(clear, set, mask);
+	}
+	RAYTRACING_AVX2_INLINE int bits(const Lanes mask) {return _mm256_movemask_pd(mask);}
+#endif
+
+	// The dot product of two vectors held one component per register
+	RAYTRACING_AVX2_INLINE Lanes dot(const Lanes ax, const Lanes ay, const Lanes az, const Lanes bx, const Lanes by,
+		const Lanes bz) {
+		return add(add(mul(ax, bx), mul(ay, by)), mul(az, bz));
+	}
+}
+#endif
+
+#endif //RAYTRACING_REALLANES_H
@@ -0,0 +1 @@
+#include "RenderReport.h"
\ No newline at end of file
@@ -0,0 +1,80 @@
+#ifndef RAYTRACING_RENDERREPORT_H
+#define RAYTRACING_RENDERREPORT_H
+#include <algorithm>
+#include <ostream>
+#include <vector>
+
+#include "RenderStats.h"
+
+// Per-frame statistics gathered by the tiled renderer
+class RenderReport {
+public:
+	// Work done by a single worker thread
+	struct ThreadReport {
+		int tiles = 0;
+		int stolenTiles = 0;
+		double busySeconds = 0;
+	};
+
+	std::vector<ThreadReport> threads;
+	int tiles = 0;
+	double seconds = 0;
+
+	// Counters and stage times of all threads together, only filled in when built with RAYTRACING_STATS
+	RenderStats::Counters stats;
+
+	[[nodiscard]] double tilesPerSecond() const {return seconds > 0 ? tiles / seconds : 0;}
+
+	// Ratio of the busiest thread's time to the mean, 1 means perfectly balanced
+	[[nodiscard]] double loadImbalance() const {
+		if (threads.empty()) return 1;
+		double total = 0, busiest = 0;
+		for (const ThreadReport& thread : threads) {
+			total += thread.busySeconds;
+			busiest = std::max(busiest, thread.busySeconds);
+		}
+		return total > 0 ? busiest * threads.size() / total : 1;
+	}
+
+	void print(std::ostream& out) const {
+		out << "Rendered " << tiles << " tiles in " << seconds << "s on " << threads.size() << " threads ("
+			<< tilesPerSecond() << " tiles/s, load imbalance " << loadImbalance() << ")" << std::endl;
+		for (size_t i = 0; i < threads.size(); ++i) {
+			out << "  thread " << i << ": " << threads[i].tiles << " tiles (" << threads[i].stolenTiles
+				<< " stolen), " << threads[i].busySeconds << "s busy" << std::endl;
+		}
+		if (!RenderStats::ENABLED) return;
+		for (std::size_t i = 0; i < RenderStats::COUNTERS; ++i) {
+			out << "  " << RenderStats::COUNTER_NAMES[i] << ": " << stats.counts[i] << std::endl;
+		}
+		// Stage times are summed over threads, so they add up to the busy time rather than the wall time
+		for (std::size_t i = 0; i < RenderStats::STAGES; ++i) {
+			out << "  " << RenderStats::STAGE_NAMES[i] << ": " << stats.seconds[i] << "s" << std::endl;
+		}
+	}
+
+	// The same report as a JSON object, with counters and stages only present when they were compiled in
+	void printJson(std::ostream& out) const {
+		out << "{\"tiles\": " << tiles << ", \"seconds\": " << seconds << ", \"tiles_per_second\": " << tilesPerSecond()
+			<< ", \"load_imbalance\": " << loadImbalance() << ", \"threads\": [";
+		for (size_t i = 0; i < threads.size(); ++i) {
+			out << (i > 0 ? ", " : "") << "{\"tiles\": " << threads[i].tiles << ", \"stolen_tiles\": "
+				<< threads[i].stolenTiles << ", \"busy_seconds\": " << threads[i].busySeconds << "}";
+		}
+		out << "]";
+		if (RenderStats::ENABLED) {
+			out << ", \"counters\": {";
+			for (std::size_t i = 0; i < RenderStats::COUNTERS; ++i) {
+				out << (i > 0 ? ", " : "") << "\"" << RenderStats::COUNTER_NAMES[i] << "\": " << stats.counts[i];
+			}
+			out << "}, \"stage_seconds\": {";
+			for (std::size_t i = 0; i < RenderStats::STAGES; ++i) {
+				out << (i > 0 ? ", " : "") << "\"" << RenderStats::STAGE_NAMES[i] << "\": " << stats.seconds[i];
+			}
+			out << "}";
+		}
+		out << "}" << std::endl;
+	}
+};
+
+#endif //RAYTRACING_RENDERREPORT_H
@@ -0,0 +1 @@
+#include "RenderStats.h"
@@ -0,0 +1,88 @@
+#ifndef RAYTRACING_RENDERSTATS_H
+#define RAYTRACING_RENDERSTATS_H
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Counters and stage timers for finding out where render time goes, compiled in by defining RAYTRACING_STATS.
+ * Each worker thread counts into its own cache-line aligned block, bound to the thread while it renders, and the
+ * blocks are merged once the frame is done. Without RAYTRACING_STATS every call here is empty and compiles away.
+ */
+namespace RenderStats {
+#ifdef RAYTRACING_STATS
+	constexpr bool ENABLED = true;
+#else
+	constexpr bool ENABLED = false;
+#endif
+
+	enum class Counter {PrimaryRays, ReflectionRays, ShadowRays, SphereTests, PlaneTests, BVHNodes, ShadeCalls, COUNT};
+
+	enum class Stage {RayGeneration, Intersection, LightCulling, Shading, Resolve, Output, COUNT};
+
+	constexpr std::size_t COUNTERS = static_cast<std::size_t>(Counter::COUNT);
+	constexpr std::size_t STAGES = static_cast<std::size_t>(Stage::COUNT);
+
+	// Names used in both the text and JSON reports
+	constexpr std::array<const char*, COUNTERS> COUNTER_NAMES = {"primary_rays", "reflection_rays", "shadow_rays",
+		"sphere_tests", "plane_tests", "bvh_nodes", "shade_calls"};
+	constexpr std::array<const char*, STAGES> STAGE_NAMES = {"ray_generation", "intersection", "light_culling",
+		"shading", "resolve", "output"};
+
+	// One thread's counts and seconds spent per stage, padded to whole cache lines so threads never share one
+	struct alignas(64) Counters {
+		std::array<std::uint64_t, COUNTERS> counts{};
+		std::array<double, STAGES> seconds{};
+
+		[[nodiscard]] std::uint64_t get(const Counter counter) const {return counts[static_cast<std::size_t>(counter)];}
+
+		[[nodiscard]] double get(const Stage stage) const {return seconds[static_cast<std::size_t>(stage)];}
+
+		void merge(const Counters& other) {
+			for (std::size_t i = 0; i < COUNTERS; ++i) {counts[i] += other.counts[i];}
+			for (std::size_t i = 0; i < STAGES; ++i) {seconds[i] += other.seconds[i];}
+		}
+	};
+
+#ifdef RAYTRACING_STATS
+	// The block the calling thread counts into, none while it is not rendering
+	inline thread_local Counters* current = nullptr;
+
+	inline void bind(Counters* counters) {current = counters;}
+
+	inline void add(const Counter counter, const std::uint64_t amount = 1) {
+		if (current) current->counts[static_cast<std::size_t>(counter)] += amount;
+	}
+
+	// Adds the time from its construction to its destruction to a stage
+	class StageTimer {
+		Stage stage;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	public:
+		explicit StageTimer(const Stage stage) : stage(stage) {}
+
+		StageTimer(const StageTimer&) = delete;
+		StageTimer& operator=(const StageTimer&) = delete;
+
+		~StageTimer() {
+			if (current) {
+				current->seconds[static_cast<std::size_t>(stage)] +=
+					std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			}
+		}
+	};
+#else
+	inline void bind(Counters*) {}
+
+	inline void add(Counter, std::uint64_t = 1) {}
+
+	class StageTimer {
+	public:
+		explicit StageTimer(Stage) {}
+	};
+#endif
+}
+
+#endif //RAYTRACING_RENDERSTATS_H
@@ -5,14 +5,34 @@
 #ifndef RAYTRACING_RENDERER_H
 #define RAYTRACING_RENDERER_H
 
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
 #include <iostream>
 #include <ostream>
+#include <span>
+#include <thread>
+#include <vector>
 
 #include "Camera.h"
 #include "ColorRGB.h"
+#include "Framebuffer.h"
+#include "ImageWriter.h"
+#include "LightSoA.h"
+#include "LightTree.h"
 #include "Ray.h"
+#include "Random.h"
+#include "RayPacket.h"
+#include "RayStream.h"
 #include "RaycastHit.h"
+#include "RenderReport.h"
+#include "RenderStats.h"
+#include "Resolve.h"
 #include "Scene.h"
+#include "TileQueue.h"
+#include "Tonemap.h"
 #include "Dev_SDL/include/SDL3/SDL_surface.h"
 #include "Dev_SDL/include/SDL3/SDL_pixels.h"
 
@@ -22,137 +42,491 @@ class Renderer {
 private:
 	int width, height;
 
-	// Bias factor for reflected and shadow rays
-	const double EPSILON = 0.0001;
-
 	// The number of times a ray can bounce for reflection
 	int bounces;
 
 	// Background colour of the image
 	ColorRGB backgroundColor = ColorRGB(0.001);
 
+	// The number of worker threads used to render a frame
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+
+	// The side length of the square tiles the image is split into, in pixels
+	int tileSize = 32;
+
+	// Whether primary rays are traced in 2x2 packets rather than one at a time
+	bool packetTracing = true;
+
+	// Whether tiles are traced breadth first, one bounce generation at a time, instead of recursively
+	bool wavefront = false;
+
+	// Lights sampled per shading point, or 0 to evaluate every light
+	int lightSamples = 0;
+
+	// Illumination below which a light is cut off, so that tiles only consider the lights that can reach them.
+	// 0 keeps every light at any distance.
+	Real lightCutoff = 0;
+
+	// Per thread scratch holding the lights that reach the tile being rendered, and a tree over them when they are
+	// sampled
+	struct TileLights {
+		std::vector<LightPrimitive> culled;
+		LightSoA lights;
+		LightTree tree;
+	};
+
+	// Storage each render thread reuses from tile to tile and frame to frame, so that once it has grown to the
+	// largest tile, culling lights and ordering ray batches allocate nothing
+	struct ThreadScratch {
+		TileLights tileLights;
+		RayStream::Scratch rayOrder;
+	};
+	std::vector<ThreadScratch> threadScratch;
+
+	// Counts rendered passes, so that each pass samples lights differently
+	std::uint64_t pass = 0;
+
+	// Tone mapping used when resolving the rendered image
+	Tonemap tonemap;
+
+	// Whether progress and the frame report are printed while rendering
+	bool verbose = true;
+
+	// Statistics from the most recently rendered frame
+	RenderReport lastReport;
+
+	// Each thread's counters for the frame being rendered, merged into the report when it ends
+	std::vector<RenderStats::Counters> threadStats;
+
+	// Progress through the frame being rendered
+	std::atomic<int> tilesDone = 0;
+	int frameTiles = 0;
+	std::chrono::steady_clock::time_point frameStart;
+
 public:
 	Renderer(int width, int height, int bounces) : width(width), height(height), bounces(bounces) {}
 
-	// Render an image from the scene, with the camera at the origin
+	void setThreads(const unsigned threads) {this->threads = std::max(1u, threads);}
+
+	void setTileSize(const int tileSize) {this->tileSize = std::max(1, tileSize);}
+
+	void setPacketTracing(const bool packetTracing) {this->packetTracing = packetTracing;}
+
+	void setWavefront(const bool wavefront) {this->wavefront = wavefront;}
+
+	/*
+	 * Limit each shading point to this many shadow rays by picking lights at random, in proportion to their estimated
+	 * contribution, instead of evaluating all of them. The estimate is unbiased, so averaging passes converges to
+	 * the exact result. 0 evaluates every light.
+	 */
+	void setLightSamples(const int lightSamples) {this->lightSamples = std::max(0, lightSamples);}
+
+	/*
+	 * Cut each light off where its illumination drops below the threshold, giving it a radius of influence that
+	 * grows with its intensity. Each tile then only evaluates the lights whose radius reaches its camera ray hits.
+	 * 0 disables the cutoff.
+	 */
+	void setLightCutoff(const Real threshold) {lightCutoff = std::max(static_cast<Real>(0), threshold);}
+
+	void setTonemap(const Tonemap& tonemap) {this->tonemap = tonemap;}
+
+	void setVerbose(const bool verbose) {this->verbose = verbose;}
+
+	[[nodiscard]] const Tonemap& getTonemap() const {return tonemap;}
+
+	[[nodiscard]] const RenderReport& getLastReport() const {return lastReport;}
+
+	// Render an image from the scene, seen from the scene's camera
 	 SDL_Surface* render(const Scene& scene) {
+		Framebuffer frame(width, height);
+		render(scene, frame);
 
 		// Set up image
 	 	SDL_Surface* image = SDL_CreateSurface(width, height, SDL_PIXELFORMAT_RGB24);
+		SDL_LockSurface(image);
+		Resolve::resolve(frame, tonemap, PixelFormat::RGB24, static_cast<Uint8*>(image->pixels), image->pitch, height);
+		SDL_UnlockSurface(image);
+		return image;
+	}
+
+	/*
+	 * Render one pass over the whole image and add it to the framebuffer, which must be the size of the image.
+	 * Rendering several passes into the same framebuffer averages them when it is resolved.
+	 */
+	void render(const Scene& scene, Framebuffer& frame) {
+		assert(scene.isCommitted());
+		assert(frame.getWidth() == width && frame.getHeight() == height && frame.getFirstRow() == 0);
+		beginFrame();
+		renderRows(scene, 0, height, frame);
+		frame.endPass();
+		endFrame();
+	}
+
+	/*
+	 * Render an image from the scene straight to a writer, one band of rows at a time. Each band is resolved and
+	 * handed over as soon as it is finished, so only a single band of the image is ever held in memory.
+	 */
+	void render(const Scene& scene, ImageWriter& writer) {
+		assert(scene.isCommitted());
+
+		// Make bands tall enough to give every thread a few tiles, but no taller
+		const int tilesX = (width + tileSize - 1) / tileSize;
+		const int bandTiles = std::max(1, static_cast<int>((4 * threads + tilesX - 1) / tilesX));
+		const int bandHeight = std::min(height, bandTiles * tileSize);
+		Framebuffer frame(width, bandHeight);
+		const int pitch = 3 * width;
+		std::vector<Uint8> band(static_cast<size_t>(pitch) * bandHeight);
+
+		writer.begin(width, height);
+		beginFrame();
+		for (int y = 0; y < height; y += bandHeight) {
+			const int rows = std::min(bandHeight, height - y);
+			frame.clear();
+			frame.setFirstRow(y);
+			renderRows(scene, y, y + rows, frame);
+			frame.endPass();
+			{
+				RenderStats::StageTimer timer(RenderStats::Stage::Resolve);
+				Resolve::resolve(frame, tonemap, PixelFormat::RGB24, band.data(), pitch, rows);
+			}
+			RenderStats::StageTimer timer(RenderStats::Stage::Output);
+			writer.writeRows(band.data(), rows, pitch);
+		}
+		endFrame();
+		writer.finish();
+	}
+
+protected:
+	// The lights a shading point is lit by, with a tree over the same lights in the same order to sample them from
+	struct LightSet {
+		const LightSoA& lights;
+		const LightTree& tree;
+	};
+
+	static LightSet sceneLights(const Scene& scene) {return {scene.getLightSoA(), scene.getLightTree()};}
+
+	// Whether a shading point lit by count lights samples them rather than evaluating every one
+	[[nodiscard]] bool samplesLights(const std::uint32_t count) const {
+		return lightSamples > 0 && count > static_cast<std::uint32_t>(lightSamples);
+	}
+
+	// Clear the report and progress counters at the start of a frame
+	void beginFrame() {
+		lastReport = RenderReport();
+		lastReport.threads.resize(threads);
+		tilesDone = 0;
+		pass++;
+		frameTiles = ((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize);
+		frameStart = std::chrono::steady_clock::now();
+		// The calling thread counts as thread 0, including any resolving and writing it does
+		threadStats.assign(threads, RenderStats::Counters());
+		threadScratch.resize(threads);
+		RenderStats::bind(&threadStats[0]);
+	}
+
+	void endFrame() {
+		RenderStats::bind(nullptr);
+		for (const RenderStats::Counters& stats : threadStats) {lastReport.stats.merge(stats);}
+		lastReport.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count();
+		if (verbose) lastReport.print(std::cout);
+	}
+
+	// Render image rows [y0, y1) into the framebuffer, split into tiles shared out between the worker threads
+	void renderRows(const Scene& scene, const int y0, const int y1, Framebuffer& frame) {
 		// Set up camera
-		const Camera camera = {width, height};
-		Uint32 pixel_buffer[image->pitch * height];
-		// Loop over all pixels
-		for (int y = 0; y < height; ++y) {
-			for (int x = 0; x < width; ++x) {
-				Ray ray = camera.castRay(x, y); // Cast ray through pixel
-				ColorRGB linearRGB = trace(scene, ray, bounces); // Trace path of cast ray and determine colour
-				ColorRGB gammaRGB = tonemap(linearRGB);
-				pixel_buffer[x + image->pitch * y] = gammaRGB.toRGB();
-				//image->pixels[x+y*image->pitch] = gammaRGB.toRGB();
-				//SDL_MapRGB(SDL_GetPixelFormatDetails(image->format), nullptr,gammaRGB.rAsByte(),gammaRGB.gAsByte(),gammaRGB.bAsByte());
-				// Set image colour to traced colour
+		const Camera camera(scene.getCamera(), width, height);
+
+		const int tilesX = (width + tileSize - 1) / tileSize;
+		const int tilesY = (y1 - y0 + tileSize - 1) / tileSize;
+		const int tileCount = tilesX * tilesY;
+		TileQueue queue(tileCount, threads);
+		lastReport.tiles += tileCount;
+
+		auto worker = [&](const unsigned index) {
+			RenderReport::ThreadReport& report = lastReport.threads[index];
+			RenderStats::bind(&threadStats[index]);
+			const auto start = std::chrono::steady_clock::now();
+			bool stolen = false;
+			ThreadScratch& scratch = threadScratch[index];
+			for (int tile; (tile = queue.pop(index, stolen)) >= 0;) {
+				const int x0 = tile % tilesX * tileSize;
+				const int tileY0 = y0 + tile / tilesX * tileSize;
+				renderTile(scene, camera, x0, tileY0, std::min(x0 + tileSize, width), std::min(tileY0 + tileSize, y1),
+					frame, scratch.tileLights, scratch.rayOrder);
+				report.tiles++;
+				if (stolen) report.stolenTiles++;
+				// Display progress every 10% of tiles
+				if (const int done = ++tilesDone; verbose && done * 10 / frameTiles != (done - 1) * 10 / frameTiles) {
+					printf("%.2f%% completed\n", 100 * done / static_cast<double>(frameTiles));
+				}
+			}
+			report.busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			if (index != 0) RenderStats::bind(nullptr);
+		};
+
+		// The calling thread works as well as the pool
+		std::vector<std::thread> pool;
+		for (unsigned i = 1; i < threads; ++i) {pool.emplace_back(worker, i);}
+		worker(0);
+		for (std::thread& thread : pool) {thread.join();}
+	}
+
+	// Render the pixels in [x0, x1) x [y0, y1), adding their colours to the framebuffer
+	void renderTile(const Scene& scene, const Camera& camera, const int x0, const int y0, const int x1, const int y1,
+		Framebuffer& frame, TileLights& tileLights, RayStream::Scratch& rayOrder) {
+		if (wavefront) {
+			renderTileWavefront(scene, camera, x0, y0, x1, y1, frame, tileLights, rayOrder);
+			return;
+		}
+		// Every primary ray is intersected before any is shaded, so the lights can be culled against the hits first
+		const int tileWidth = x1 - x0;
+		const size_t pixels = static_cast<size_t>(tileWidth) * (y1 - y0);
+		RenderStats::add(RenderStats::Counter::PrimaryRays, pixels);
+		std::vector<Ray> rays;
+		rays.reserve(pixels);
+		{
+			RenderStats::StageTimer timer(RenderStats::Stage::RayGeneration);
+			for (int y = y0; y < y1; ++y) {
+				camera.castRays(x0, x1, y, rays); // Cast rays through the row's pixels
 			}
-			// Display progress every 10 lines
-			if(y%10==9||y==height-1) {
-				printf("%.2f", 100 * y / static_cast<double>(height-1));
-				std::cout << "% completed" << std::endl;
+		}
+		std::vector<Intersection> hits(pixels);
+		{
+			RenderStats::StageTimer timer(RenderStats::Stage::Intersection);
+			if (packetTracing) {
+				intersectPackets(scene, rays, tileWidth, hits);
+			} else {
+				for (size_t i = 0; i < pixels; ++i) {hits[i] = scene.intersect(rays[i]);}
 			}
 		}
-		SDL_LockSurface(image);
-		SDL_memcpy(image->pixels, pixel_buffer, image->pitch * height * 4);
-		SDL_UnlockSurface(image);
-		return image;
+
+		const LightSet lights = cullLights(scene, rays, hits, tileLights);
+		// Reflections are traced as part of shading the hits that spawn them
+		RenderStats::StageTimer timer(RenderStats::Stage::Shading);
+		for (size_t i = 0; i < pixels; ++i) {
+			// Trace path of cast ray and determine colour
+			const ColorRGB linearRGB = shade(scene, lights, rays[i], hits[i], bounces);
+			frame.accumulate(x0 + static_cast<int>(i) % tileWidth, y0 + static_cast<int>(i) / tileWidth, linearRGB);
+		}
 	}
 
+	// Intersect a tile's primary rays, stored row by row, in 2x2 pixel blocks traced together as packets
+	void intersectPackets(const Scene& scene, const std::vector<Ray>& rays, const int tileWidth,
+		std::vector<Intersection>& hits) const {
+		const int tileHeight = static_cast<int>(rays.size()) / tileWidth;
+		for (int y = 0; y < tileHeight; y += 2) {
+			for (int x = 0; x < tileWidth; x += 2) {
+				// Lanes that fall off the edge of the tile repeat the first pixel and are left inactive
+				const Ray& corner = rays[y * tileWidth + x];
+				std::array<Ray, RayPacket::SIZE> packetRays = {corner, corner, corner, corner};
+				unsigned active = 0;
+				for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+					const int px = x + lane % 2, py = y + lane / 2;
+					if (px >= tileWidth || py >= tileHeight) continue;
+					packetRays[lane] = rays[py * tileWidth + px];
+					active |= 1u << lane;
+				}
+				const std::array<Intersection, RayPacket::SIZE> packetHits = scene.intersect(RayPacket(packetRays, active));
+				for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+					if (active & 1u << lane) hits[(y + lane / 2) * tileWidth + x + lane % 2] = packetHits[lane];
+				}
+			}
+		}
+	}
 
-	// Combined tone mapping and display encoding
-	static ColorRGB tonemap(const ColorRGB& linearRGB) {
-		constexpr double invGamma = 1./2.2;
-		constexpr double a = 2;  // controls brightness
-		constexpr double b = 1.3; // controls contrast
-		// Sigmoidal tone mapping
-		const ColorRGB powRGB = linearRGB.power(b);
-		const ColorRGB displayRGB = powRGB.scale(powRGB.add(pow(0.5/a,b)).inv());
-		// Display encoding - gamma
-		const ColorRGB gammaRGB = displayRGB.power(invGamma);
-		return gammaRGB;
+	/*
+	 * Find the lights that can reach any of a tile's primary hits. With a light cutoff set, only lights whose sphere
+	 * of influence touches the bounding box of the hits are copied into the tile's own list, with a light tree built
+	 * over them if there are more than the light samples. Without one every light reaches everywhere, and the
+	 * scene's lights are used as they are.
+	 */
+	LightSet cullLights(const Scene& scene, const std::span<const Ray> rays,
+		const std::span<const Intersection> hits, TileLights& tileLights) const {
+		if (lightCutoff <= 0) return sceneLights(scene);
+		RenderStats::StageTimer timer(RenderStats::Stage::LightCulling);
+		AABB bounds;
+		for (size_t i = 0; i < rays.size(); ++i) {
+			if (hits[i].isHit()) bounds.grow(rays[i].evaluateAt(hits[i].distance));
+		}
+		tileLights.culled.clear();
+		if (!bounds.isEmpty()) {
+			for (const LightPrimitive& light : scene.getLights()) {
+				const Real radius = light.getInfluenceRadius(lightCutoff);
+				if (bounds.distanceSquared(light.position) <= radius * radius) tileLights.culled.push_back(light);
+			}
+		}
+		tileLights.lights.assign(tileLights.culled);
+		if (samplesLights(tileLights.lights.size())) tileLights.tree.build(tileLights.culled);
+		return {tileLights.lights, tileLights.tree};
+	}
+
+	/*
+	 * Render a tile breadth first. All camera rays of the tile are intersected as one batch and shaded as one batch,
+	 * and the reflection rays they spawn form the next wave, until the bounces run out or no rays are left.
+	 */
+	void renderTileWavefront(const Scene& scene, const Camera& camera, const int x0, const int y0, const int x1,
+		const int y1, Framebuffer& frame, TileLights& tileLights, RayStream::Scratch& rayOrder) {
+		const int tileWidth = x1 - x0;
+		std::vector<ColorRGB> colours(static_cast<size_t>(tileWidth) * (y1 - y0), ColorRGB(0));
+
+		// Each ray in a wave remembers its pixel and how much it contributes to that pixel's colour
+		std::vector<Ray> rays, nextRays;
+		std::vector<std::uint32_t> pixelOf, nextPixelOf;
+		std::vector<ColorRGB> weights, nextWeights;
+		std::vector<Intersection> hits;
+		{
+			RenderStats::StageTimer timer(RenderStats::Stage::RayGeneration);
+			for (int y = y0; y < y1; ++y) {
+				camera.castRays(x0, x1, y, rays);
+				for (int x = x0; x < x1; ++x) {
+					pixelOf.push_back((y - y0) * tileWidth + (x - x0));
+					weights.emplace_back(1);
+				}
+			}
+		}
+		RenderStats::add(RenderStats::Counter::PrimaryRays, rays.size());
+
+		for (int bouncesLeft = bounces; !rays.empty(); --bouncesLeft) {
+			hits.resize(rays.size());
+			{
+				RenderStats::StageTimer timer(RenderStats::Stage::Intersection);
+				scene.intersect(std::span<const Ray>(rays), std::span<Intersection>(hits), rayOrder);
+			}
+			// Only the camera rays' hits lie within the tile's light list, reflections can land anywhere
+			const LightSet lights = bouncesLeft == bounces ? cullLights(scene, rays, hits, tileLights) : sceneLights(scene);
+			RenderStats::StageTimer timer(RenderStats::Stage::Shading);
+			nextRays.clear();
+			nextPixelOf.clear();
+			nextWeights.clear();
+			for (size_t i = 0; i < rays.size(); ++i) {
+				ColorRGB& colour = colours[pixelOf[i]];
+				if (!hits[i].isHit()) {
+					colour = colour.add(weights[i].scale(backgroundColor));
+					continue;
+				}
+				RenderStats::add(RenderStats::Counter::ShadeCalls);
+				const RaycastHit hit = scene.resolve(rays[i], hits[i]);
+				const ColorRGB directIllumination = illuminate(scene, lights, hit.getMaterial(), hit.getLocation(),
+					hit.getNormal(), rays[i].getOrigin());
+				if (const Real reflectivity = hit.getMaterial().getReflectivity(); bouncesLeft == 0 || reflectivity == 0) {
+					colour = colour.add(weights[i].scale(directIllumination));
+				} else {
+					colour = colour.add(weights[i].scale(directIllumination.scale(1.0 - reflectivity)));
+					nextRays.push_back(reflectedRay(rays[i], hit));
+					nextPixelOf.push_back(pixelOf[i]);
+					nextWeights.push_back(weights[i].scale(reflectivity));
+				}
+			}
+			RenderStats::add(RenderStats::Counter::ReflectionRays, nextRays.size());
+			std::swap(rays, nextRays);
+			std::swap(pixelOf, nextPixelOf);
+			std::swap(weights, nextWeights);
+		}
+
+		for (int y = y0; y < y1; ++y) {
+			for (int x = x0; x < x1; ++x) {frame.accumulate(x, y, colours[(y - y0) * tileWidth + (x - x0)]);}
+		}
 	}
 
 	/*
 	 * Trace the ray through the supplied scene, returning the colour to be rendered.
 	 * The bouncesLeft parameter is for rendering reflective surfaces.
 	 */
-protected:
 	ColorRGB trace(const Scene& scene, const Ray &ray, const int bouncesLeft) {
-
         // Find closest intersection of ray in the scene
-		RaycastHit* closestHit = scene.findClosestIntersection(ray);
+		return shade(scene, sceneLights(scene), ray, scene.intersect(ray), bouncesLeft);
+	}
+
+	/*
+	 * Determine the colour seen along a ray, given its closest intersection with the scene. The hit is lit by the given
+	 * lights, which must include every light that can reach it, and anything it reflects by all of the scene's lights.
+	 */
+	ColorRGB shade(const Scene& scene, const LightSet& lights, const Ray &ray, const Intersection &intersection,
+		const int bouncesLeft) {
 		// If no object has been hit, return a background colour
-		if (closestHit->getDistance() == std::numeric_limits<double>::infinity()) {return backgroundColor;}
+		if (!intersection.isHit()) {return backgroundColor;}
+		RenderStats::add(RenderStats::Counter::ShadeCalls);
+		const RaycastHit closestHit = scene.resolve(ray, intersection);
 
-        const SceneObject object = closestHit->getObjectHit();
+        const Material& material = closestHit.getMaterial();
 
         // Otherwise calculate colour at intersection and return
         // Get properties of surface at intersection - location, surface normal
-        const Vector3 P = closestHit->getLocation();
-        const Vector3 N = closestHit->getNormal();
+        const Vector3 P = closestHit.getLocation();
+        const Vector3 N = closestHit.getNormal();
         const Vector3 O = ray.getOrigin();
 
-        ColorRGB directIllumination = this->illuminate(scene, object, P, N, O);
-        if (const double reflectivity = object.getReflectivity(); bouncesLeft == 0 || reflectivity == 0) {return directIllumination;}
+        ColorRGB directIllumination = this->illuminate(scene, lights, material, P, N, O);
+        if (const Real reflectivity = material.getReflectivity(); bouncesLeft == 0 || reflectivity == 0) {return directIllumination;}
         else { // Recursive case
-            const Vector3 R = ray.getDirection().normalised().reflectIn(N.normalised()).normalised().scale(-1);
-            const Ray reflectedRay =  {P.add(N.scale(EPSILON)), R};
-            ColorRGB reflectedIllumination = trace(scene, reflectedRay, bouncesLeft-1);
+            RenderStats::add(RenderStats::Counter::ReflectionRays);
+            ColorRGB reflectedIllumination = trace(scene, reflectedRay(ray, closestHit), bouncesLeft-1);
             directIllumination = directIllumination.scale(1.0 - reflectivity);
             reflectedIllumination = reflectedIllumination.scale(reflectivity);
             // Return total illumination
             return directIllumination.add(reflectedIllumination);
         }
     }
-	/*
-	 * Illuminate a surface on and object in the scene at a given position P and surface normal N,
-	 * relative to ray originating at O
-	 */
-	[[nodiscard]] ColorRGB illuminate(Scene scene, const SceneObject& object, Vector3 P, Vector3 N, Vector3 O) const {
 
-        Vector3 normal = N.normalised();
-		auto colourToReturn = ColorRGB(0);
+	// The mirror reflection of a ray about the surface normal at its hit, offset off the surface. Camera rays and
+	// hit normals are unit length, so reflected rays are too and nothing needs normalising again.
+	[[nodiscard]] Ray reflectedRay(const Ray &ray, const RaycastHit &hit) const {
+		const Vector3 P = hit.getLocation();
+		const Vector3 N = hit.getNormal();
+		const Vector3 R = ray.getDirection().reflectIn(N).scale(-1);
+		return {Ray::offsetOrigin(P, N), R};
+	}
 
+	/*
+	 * Illuminate a surface on and object in the scene at a given position P and unit surface normal N,
+	 * relative to ray originating at O. Either every one of the given lights is evaluated, in batches, or when there
+	 * are more of them than the light sample budget that many are picked at random from them using their tree.
+	 * Shadow rays are only cast towards lights that would contribute something above the light cutoff.
+	 */
+	[[nodiscard]] ColorRGB illuminate(const Scene& scene, const LightSet& lightSet, const Material& material,
+		const Vector3& P, const Vector3& N, const Vector3& O) const {
+		const LightSoA& lights = lightSet.lights;
 		ColorRGB I_a = scene.getAmbientLighting(); // Ambient illumination intensity
-        Vector3 V = O.subtract(P).normalised();
-		ColorRGB C_diff = object.getColour(); // Diffuse colour defined by the object
+		ColorRGB C_diff = material.getColour(); // Diffuse colour defined by the material
 
 		// Get Phong reflection model coefficients
-		double k_d = object.getPhong_kD();
-		double k_s = object.getPhong_kS();
-		double alpha = object.getPhong_alpha();
-
-        colourToReturn = colourToReturn.add(C_diff.scale(I_a));
-		// Loop over each point light source
-		std::list<PointLight> pointLights = scene.getPointLights();
-		int len = pointLights.size();
-		for (int i = 0; i < len; i++) {
-            auto diffuse = ColorRGB(0);
-            auto specular = ColorRGB(0);
-			PointLight light = pointLights.front();
-			pointLights.pop_front();
-
-			// Calculate point light constants
-			double distanceToLight = light.getPosition().subtract(P).magnitude();
-			ColorRGB C_spec = light.getColour();
-			ColorRGB I = light.getIlluminationAt(distanceToLight);
-
-            Vector3 L = light.getPosition().subtract(P).normalised();
-            Vector3 R = L.reflectIn(normal).normalised();
-
-            Ray shadowRay = {P.add(N.scale(EPSILON)), L};
-            if (RaycastHit* shadowcheck = scene.findClosestIntersection(shadowRay); shadowcheck->getDistance() > distanceToLight) {
-                diffuse = C_diff.scale(I.scale(k_d * std::ranges::max(static_cast<double>(0), normal.dot(L))));
-                specular = C_spec.scale(I.scale(k_s * pow(std::ranges::max(static_cast<double>(0), R.dot(V)), alpha)));
-            }
-            colourToReturn = colourToReturn.add(diffuse).add(specular);
+		Real k_d = material.getPhong_kD();
+		Real k_s = material.getPhong_kS();
+		Real alpha = material.getPhong_alpha();
+
+		const LightSoA::ShadingPoint point = {P, N, O.subtract(P).normalised()};
+		const Vector3 shadowOrigin = Ray::offsetOrigin(P, N);
+		LightSoA::Terms terms;
+
+		// Unshadowed Phong terms of light i of the evaluated batch, which is light index of the light list
+		auto contribution = [&](const LightSoA& list, const std::uint32_t i, const std::uint32_t index) {
+			const Real diffuse = k_d * std::max(static_cast<Real>(0), terms.nDotL[i]);
+			const Real specular = k_s == 0 ? 0 : k_s * std::pow(std::max(static_cast<Real>(0), terms.rDotV[i]), alpha);
+			if (diffuse == 0 && specular == 0) return ColorRGB(0);
+			const ColorRGB I = list.getRadiantIntensity(index).scale(terms.falloff[i]);
+			if (lightCutoff > 0 && std::max({I.r(), I.g(), I.b()}) < lightCutoff) return ColorRGB(0);
+
+			RenderStats::add(RenderStats::Counter::ShadowRays);
+			const Ray shadowRay = {shadowOrigin, Vector3(terms.lx[i], terms.ly[i], terms.lz[i])};
+			if (scene.isOccluded(shadowRay, terms.distance[i])) return ColorRGB(0);
+			return C_diff.scale(I.scale(diffuse)).add(list.getColour(index).scale(I.scale(specular)));
+		};
+
+		auto colourToReturn = C_diff.scale(I_a);
+		if (samplesLights(lights.size())) {
+			// Each sample is one light divided by the probability of picking it
+			const std::uint64_t seed = Random::combine(Random::hash(P), pass);
+			for (int sample = 0; sample < lightSamples; ++sample) {
+				const auto [light, pdf] = lightSet.tree.sample(P, Random::toUnit(Random::combine(seed, sample)));
+				lights.evaluate(point, light, 1, terms);
+				colourToReturn = colourToReturn.add(contribution(lights, 0, light).scale(1 / (pdf * lightSamples)));
+			}
+			return colourToReturn;
+		}
+		for (std::uint32_t first = 0; first < lights.size(); first += LightSoA::BATCH) {
+			const std::uint32_t count = std::min(LightSoA::BATCH, lights.size() - first);
+			lights.evaluate(point, first, count, terms);
+			for (std::uint32_t i = 0; i < count; ++i) {colourToReturn = colourToReturn.add(contribution(lights, i, first + i));}
 		}
 		return colourToReturn;
 	}
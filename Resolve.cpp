@@ -0,0 +1 @@
+#include "Resolve.h"
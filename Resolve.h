@@ -0,0 +1,84 @@
+#ifndef RAYTRACING_RESOLVE_H
+#define RAYTRACING_RESOLVE_H
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "Framebuffer.h"
+#include "Tonemap.h"
+
+// Layouts a framebuffer can be resolved to
+enum class PixelFormat {
+	RGB24,  // 8 bits per channel, display encoded
+	RGBA8,  // 8 bits per channel plus opaque alpha, display encoded
+	RGB32F  // Linear float radiance averaged over the passes, without tone mapping
+};
+
+/*
+ * Turns the accumulated radiance in a framebuffer into output pixels: averages the passes, tone maps and display
+ * encodes each channel, then packs the channels into the requested layout. Each channel of a row is encoded as one
+ * contiguous float array.
+ */
+class Resolve {
+public:
+	[[nodiscard]] static constexpr int bytesPerPixel(const PixelFormat format) {
+		return format == PixelFormat::RGB24 ? 3 : format == PixelFormat::RGBA8 ? 4 : 12;
+	}
+
+	/*
+	 * Resolve the first rows of the framebuffer into pixels, which must have room for that many rows of pitch bytes.
+	 */
+	static void resolve(const Framebuffer& frame, const Tonemap& tonemap, const PixelFormat format, std::uint8_t* pixels,
+		const int pitch, const int rows) {
+		const int width = frame.getWidth();
+		const float scale = frame.getPasses() > 0 ? 1.f / static_cast<float>(frame.getPasses()) : 0.f;
+		std::vector<float> mapped(static_cast<size_t>(Framebuffer::CHANNELS) * width);
+		std::vector<std::uint8_t> bytes(mapped.size());
+
+		for (int y = 0; y < rows; ++y) {
+			std::uint8_t* out = pixels + static_cast<size_t>(y) * pitch;
+			for (int channel = 0; channel < Framebuffer::CHANNELS; ++channel) {
+				const float* in = frame.row(channel, y);
+				float* mappedChannel = mapped.data() + static_cast<size_t>(channel) * width;
+				if (format == PixelFormat::RGB32F) {
+					for (int x = 0; x < width; ++x) {mappedChannel[x] = in[x] * scale;}
+					continue;
+				}
+				std::uint8_t* byteChannel = bytes.data() + static_cast<size_t>(channel) * width;
+				tonemap.encode(in, scale, mappedChannel, byteChannel, width);
+			}
+			pack(format, width, mapped.data(), bytes.data(), out);
+		}
+	}
+
+private:
+	// Interleave the channel planes of one row into the output layout
+	static void pack(const PixelFormat format, const int width, const float* mapped, const std::uint8_t* bytes,
+		std::uint8_t* out) {
+		switch (format) {
+			case PixelFormat::RGB24:
+				for (int x = 0; x < width; ++x) {
+					out[3 * x] = bytes[x];
+					out[3 * x + 1] = bytes[width + x];
+					out[3 * x + 2] = bytes[2 * width + x];
+				}
+				break;
+			case PixelFormat::RGBA8:
+				for (int x = 0; x < width; ++x) {
+					out[4 * x] = bytes[x];
+					out[4 * x + 1] = bytes[width + x];
+					out[4 * x + 2] = bytes[2 * width + x];
+					out[4 * x + 3] = 255;
+				}
+				break;
+			case PixelFormat::RGB32F:
+				for (int x = 0; x < width; ++x) {
+					const float pixel[3] = {mapped[x], mapped[width + x], mapped[2 * width + x]};
+					std::memcpy(out + 12 * static_cast<size_t>(x), pixel, sizeof(pixel));
+				}
+				break;
+		}
+	}
+};
+
+#endif //RAYTRACING_RESOLVE_H
@@ -4,51 +4,414 @@
 
 #ifndef RAYTRACING_SCENE_H
 #define RAYTRACING_SCENE_H
-#include <list>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
 
+#include "BVH.h"
+#include "Camera.h"
+#include "Intersection.h"
+#include "LightSoA.h"
+#include "LightTree.h"
+#include "Material.h"
+#include "Plane.h"
 #include "PointLight.h"
+#include "RayPacket.h"
+#include "RayStream.h"
 #include "RaycastHit.h"
-#include "SceneObject.h"
+#include "RenderStats.h"
+#include "Sphere.h"
+#include "SphereSoA.h"
 
 class Scene {
+    // Saves and restores the committed state directly
+    friend class SceneFile;
 
-    // A list of 3D objects to be rendered
+    // Surface properties of the objects, referenced by index from the primitives
 private:
-    std::list<SceneObject> objects;
+    std::vector<Material> materials;
 
-    // A list of point light sources
-    std::list<PointLight> pointLights;
+    // Index of every distinct material added so far, so that objects with identical materials share one entry
+    struct MaterialHash {
+        std::size_t operator()(const Material& material) const {return material.hash();}
+    };
+    struct MaterialEquals {
+        bool operator()(const Material& a, const Material& b) const {return a.equals(b);}
+    };
+    std::unordered_map<Material, std::uint32_t, MaterialHash, MaterialEquals> materialIndices;
+
+    // The 3D objects to be rendered, stored contiguously by type. After commit the spheres are in BVH leaf order.
+    std::vector<SpherePrimitive> spheres;
+    std::vector<PlanePrimitive> planes;
+
+    // Sphere centres and squared radii in the same order, for the vectorised intersection kernels
+    SphereSoA sphereSoA;
+
+    // Bounding volume hierarchy over the spheres, and the bounds of everything but the planes
+    BVH bvh;
+    AABB bounds;
+    bool committed = false;
+
+    // The point light sources as they were added, and the compact copy built from them by commit
+    std::vector<PointLight> pointLights;
+    std::vector<LightPrimitive> lights;
+    LightSoA lightSoA;
+    LightTree lightTree;
 
     // The color of the ambient light in the scene
     ColorRGB ambientLight;
 
+    // The viewpoint the scene is rendered from
+    CameraSettings camera;
+
+    // Update the closest intersection with any plane hit before it
+    void intersectPlanes(const Ray &ray, Intersection &closest) const {
+        RenderStats::add(RenderStats::Counter::PlaneTests, planes.size());
+        for (std::uint32_t i = 0; i < planes.size(); ++i) {
+            if (const Real distance = planes[i].intersectDistance(ray); distance < closest.distance) {
+                closest = {distance, PrimitiveType::Plane, i};
+            }
+        }
+    }
+
+    // Update the closest intersection with any of spheres [first, first + count) hit before it
+    void intersectSpheres(const SphereSoA::RayConstants &ray, const std::uint32_t first, const std::uint32_t count,
+        Intersection &closest) const {
+        RenderStats::add(RenderStats::Counter::SphereTests, count);
+        if (const int i = sphereSoA.intersect(ray, first, count, closest.distance); i >= 0) {
+            closest.type = PrimitiveType::Sphere;
+            closest.index = i;
+        }
+    }
+
+    // Whether any of spheres [first, first + count) blocks the ray before tMax
+    bool spheresOcclude(const SphereSoA::RayConstants &ray, const std::uint32_t first, const std::uint32_t count,
+        Real tMax) const {
+        RenderStats::add(RenderStats::Counter::SphereTests, count);
+        return sphereSoA.intersect(ray, first, count, tMax) >= 0;
+    }
+
+    /*
+     * Trace a batch of rays in the given order, handing runs of up to a packet's worth of consecutive rays with the
+     * same origin to tracePacket(packet, indices, run) and any other ray to traceSingle(index).
+     */
+    template <typename TraceSingle, typename TracePacket>
+    static void traceCoherent(const std::span<const Ray> rays, const std::span<const std::uint32_t> order,
+        TraceSingle &&traceSingle, TracePacket &&tracePacket) {
+        for (size_t i = 0; i < order.size();) {
+            const Vector3 origin = rays[order[i]].getOrigin();
+            int run = 1;
+            while (run < RayPacket::SIZE && i + run < order.size() && rays[order[i + run]].getOrigin().equals(origin)) {
+                run++;
+            }
+            if (run == 1) {
+                traceSingle(order[i]);
+            } else {
+                // Lanes past the end of the run repeat its first ray and are left inactive
+                const Ray &first = rays[order[i]];
+                std::array<Ray, RayPacket::SIZE> packetRays = {first, first, first, first};
+                for (int lane = 1; lane < run; ++lane) {packetRays[lane] = rays[order[i + lane]];}
+                tracePacket(RayPacket(packetRays, (1u << run) - 1), &order[i], run);
+            }
+            i += run;
+        }
+    }
+
+    // Build the BVH over the spheres and store them in leaf order, so every leaf covers a contiguous range of them
+    void buildHierarchy(const unsigned threads) {
+        std::vector<AABB> sphereBounds;
+        sphereBounds.reserve(spheres.size());
+        for (const SpherePrimitive& sphere : spheres) {sphereBounds.push_back(sphere.getBounds());}
+        bvh.build(sphereBounds, threads);
+
+        std::vector<SpherePrimitive> ordered;
+        ordered.reserve(spheres.size());
+        for (const std::uint32_t index : bvh.getOrder()) {ordered.push_back(spheres[index]);}
+        spheres = std::move(ordered);
+    }
+
+    // Derive the bounds and the vectorised copies of the spheres and lights, once they are in their final order
+    void finalise() {
+        bounds = AABB();
+        for (const SpherePrimitive& sphere : spheres) {bounds.grow(sphere.getBounds());}
+        for (const LightPrimitive& light : lights) {bounds.grow(light.position);}
+        sphereSoA.assign(spheres);
+        lightSoA.assign(lights);
+        lightTree.build(lights);
+        // Nothing more can be added once committed, so the material lookup is only taking up memory
+        materialIndices = {};
+        committed = true;
+    }
+
+    // A committed scene is frozen, so that it can be shared between threads without locking
+    void requireEditable() const {
+        if (committed) throw std::logic_error("a committed scene cannot be modified");
+    }
+
 public:
     Scene() : ambientLight(ColorRGB(1)) {}
 
-    void addObject(const SceneObject& object) {objects.push_back(object);}
+    // Add a material, returning the index primitives refer to it by. A material identical to one already added
+    // gets the index of that one.
+    std::uint32_t addMaterial(const Material& material) {
+        requireEditable();
+        const auto [entry, added] = materialIndices.try_emplace(material, static_cast<std::uint32_t>(materials.size()));
+        if (added) materials.push_back(material);
+        return entry->second;
+    }
 
-    // Find the closest intersection of given ray with an object in the scene
-    [[nodiscard]] RaycastHit* findClosestIntersection(const Ray &ray) const {
-    auto* closestHit = new RaycastHit(); // initially no intersection
+    void addObject(const Sphere& sphere) {spheres.push_back(sphere.toPrimitive(addMaterial(sphere.getMaterial())));}
 
-    // Loop over objects and find closest intersection
-    for (SceneObject object : objects) {
-        if (RaycastHit* trialHit = object.intersectionWith(ray); trialHit->getDistance() < closestHit->getDistance()) {
-            closestHit = trialHit;
+    void addObject(const Plane& plane) {planes.push_back(plane.toPrimitive(addMaterial(plane.getMaterial())));}
+
+    // Move the objects and lights of another uncommitted scene onto the end of this one, as if they had been added
+    // here in the same order. Its camera and ambient light are left behind.
+    void append(Scene&& other) {
+        requireEditable();
+        other.requireEditable();
+        std::vector<std::uint32_t> materialIndex;
+        materialIndex.reserve(other.materials.size());
+        for (const Material& material : other.materials) {materialIndex.push_back(addMaterial(material));}
+        spheres.reserve(spheres.size() + other.spheres.size());
+        for (SpherePrimitive sphere : other.spheres) {
+            sphere.material = materialIndex[sphere.material];
+            spheres.push_back(sphere);
+        }
+        planes.reserve(planes.size() + other.planes.size());
+        for (PlanePrimitive plane : other.planes) {
+            plane.material = materialIndex[plane.material];
+            planes.push_back(plane);
         }
+        pointLights.insert(pointLights.end(), other.pointLights.begin(), other.pointLights.end());
+        other = Scene();
+    }
+
+    /*
+     * Finalise the scene once everything has been added: build the BVH over the spheres and the compact light array,
+     * and freeze the scene. Every query requires a committed scene, and a committed scene cannot be modified, so it
+     * is safe to read from any number of threads at once. The BVH can be built on several threads.
+     */
+    void commit(const unsigned threads = 1) {
+        if (committed) return;
+        buildHierarchy(threads);
+        lights.clear();
+        lights.reserve(pointLights.size());
+        for (const PointLight& light : pointLights) {lights.push_back(light.toPrimitive());}
+        finalise();
     }
-    return closestHit;
-}
+
+    [[nodiscard]] bool isCommitted() const {return committed;}
+
+    // Bounds of the spheres and lights, the planes are unbounded and left out
+    [[nodiscard]] const AABB& getBounds() const {return bounds;}
+
+    // Find the distance to the closest intersection and the primitive hit, without evaluating the surface there
+    [[nodiscard]] Intersection intersect(const Ray &ray) const {
+        assert(committed);
+        Intersection closest; // initially no intersection
+
+        // Loop over the planes, then walk the BVH for the spheres
+        intersectPlanes(ray, closest);
+        const SphereSoA::RayConstants constants = SphereSoA::constantsFor(ray);
+        bvh.traverse(ray, closest.distance, [&](const std::uint32_t first, const std::uint32_t count) {
+            intersectSpheres(constants, first, count, closest);
+            return false;
+        });
+        return closest;
+    }
+
+    // Find the closest intersection for every active lane of a packet of coherent rays
+    [[nodiscard]] std::array<Intersection, RayPacket::SIZE> intersect(const RayPacket &packet) const {
+        assert(committed);
+        std::array<Intersection, RayPacket::SIZE> closest;
+        std::array<Real, RayPacket::SIZE> tMax;
+        tMax.fill(closest[0].distance);
+
+        // Test every lane against each plane at once, then walk the BVH for the spheres
+        RenderStats::add(RenderStats::Counter::PlaneTests, planes.size() * std::popcount(packet.getActive()));
+        for (std::uint32_t i = 0; i < planes.size(); ++i) {
+            unsigned hits = packet.intersectPlane(planes[i].normal, planes[i].offset, tMax, packet.getActive());
+            for (; hits != 0; hits &= hits - 1) {
+                const int lane = std::countr_zero(hits);
+                closest[lane] = {tMax[lane], PrimitiveType::Plane, i};
+            }
+        }
+        std::array<SphereSoA::RayConstants, RayPacket::SIZE> constants;
+        for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+            constants[lane] = SphereSoA::constantsFor(packet.getRay(lane));
+        }
+        bvh.traversePacket(packet, tMax,
+            [&](const std::uint32_t first, const std::uint32_t count, unsigned lanes) {
+                for (; lanes != 0; lanes &= lanes - 1) {
+                    const int lane = std::countr_zero(lanes);
+                    intersectSpheres(constants[lane], first, count, closest[lane]);
+                    tMax[lane] = closest[lane].distance;
+                }
+                return 0u;
+            },
+            // A lane that has left the rest of the packet finishes the subtree as a single ray
+            [&](const int lane, const std::uint32_t node) {
+                bvh.traverse(packet.getRay(lane), closest[lane].distance,
+                    [&](const std::uint32_t first, const std::uint32_t count) {
+                        intersectSpheres(constants[lane], first, count, closest[lane]);
+                        return false;
+                    }, node);
+                tMax[lane] = closest[lane].distance;
+                return false;
+            });
+        return closest;
+    }
+
+    /*
+     * Intersect a batch of rays, writing the closest intersection of rays[i] to hits[i]. The batch is traced in
+     * direction order so neighbouring rays walk the same part of the BVH, and runs of rays sharing an origin are
+     * traced together as packets. The order is sorted in the caller's scratch buffers.
+     */
+    void intersect(const std::span<const Ray> rays, const std::span<Intersection> hits,
+        RayStream::Scratch &scratch) const {
+        assert(rays.size() == hits.size());
+        traceCoherent(rays, RayStream::coherentOrder(rays, scratch),
+            [&](const std::uint32_t i) {hits[i] = intersect(rays[i]);},
+            [&](const RayPacket &packet, const std::uint32_t *indices, const int run) {
+                const std::array<Intersection, RayPacket::SIZE> packetHits = intersect(packet);
+                for (int lane = 0; lane < run; ++lane) {hits[indices[lane]] = packetHits[lane];}
+            });
+    }
+
+    // Determine whether anything blocks the ray before tMax, stopping at the first blocker found
+    [[nodiscard]] bool isOccluded(const Ray &ray, const Real tMax) const {
+        assert(committed);
+        for (const PlanePrimitive& plane : planes) {
+            RenderStats::add(RenderStats::Counter::PlaneTests);
+            if (plane.intersectDistance(ray) < tMax) return true;
+        }
+        const SphereSoA::RayConstants constants = SphereSoA::constantsFor(ray);
+        bool occluded = false;
+        Real distanceLimit = tMax;
+        bvh.traverse(ray, distanceLimit, [&](const std::uint32_t first, const std::uint32_t count) {
+            occluded = spheresOcclude(constants, first, count, tMax);
+            return occluded;
+        });
+        return occluded;
+    }
+
+    // Determine which active lanes of a packet are blocked before their tMax, returning the mask of them
+    [[nodiscard]] unsigned isOccluded(const RayPacket &packet, const std::array<Real, RayPacket::SIZE> &tMax) const {
+        assert(committed);
+        std::array<Real, RayPacket::SIZE> limit = tMax;
+        unsigned occluded = 0;
+        RenderStats::add(RenderStats::Counter::PlaneTests, planes.size() * std::popcount(packet.getActive()));
+        for (const PlanePrimitive& plane : planes) {
+            occluded |= packet.intersectPlane(plane.normal, plane.offset, limit, packet.getActive());
+        }
+        if (occluded == packet.getActive()) return occluded;
+
+        limit = tMax;
+        std::array<SphereSoA::RayConstants, RayPacket::SIZE> constants;
+        for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+            constants[lane] = SphereSoA::constantsFor(packet.getRay(lane));
+        }
+        bvh.traversePacket(packet, limit,
+            [&](const std::uint32_t first, const std::uint32_t count, const unsigned lanes) {
+                for (unsigned remaining = lanes & ~occluded; remaining != 0; remaining &= remaining - 1) {
+                    const int lane = std::countr_zero(remaining);
+                    if (spheresOcclude(constants[lane], first, count, tMax[lane])) occluded |= 1u << lane;
+                }
+                return occluded;
+            },
+            [&](const int lane, const std::uint32_t node) {
+                if (occluded & 1u << lane) return true;
+                Real distanceLimit = tMax[lane];
+                bvh.traverse(packet.getRay(lane), distanceLimit,
+                    [&](const std::uint32_t first, const std::uint32_t count) {
+                        if (spheresOcclude(constants[lane], first, count, tMax[lane])) occluded |= 1u << lane;
+                        return (occluded & 1u << lane) != 0;
+                    }, node);
+                return (occluded & 1u << lane) != 0;
+            });
+        return occluded;
+    }
+
+    /*
+     * Test a batch of rays for occlusion, setting occluded[i] if anything blocks rays[i] before tMax[i]. The batch is
+     * ordered and grouped into packets as intersect does.
+     */
+    void isOccluded(const std::span<const Ray> rays, const std::span<const Real> tMax,
+        const std::span<std::uint8_t> occluded, RayStream::Scratch &scratch) const {
+        assert(rays.size() == tMax.size() && rays.size() == occluded.size());
+        traceCoherent(rays, RayStream::coherentOrder(rays, scratch),
+            [&](const std::uint32_t i) {occluded[i] = isOccluded(rays[i], tMax[i]);},
+            [&](const RayPacket &packet, const std::uint32_t *indices, const int run) {
+                std::array<Real, RayPacket::SIZE> limits;
+                for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+                    limits[lane] = tMax[indices[std::min(lane, run - 1)]];
+                }
+                const unsigned blocked = isOccluded(packet, limits);
+                for (int lane = 0; lane < run; ++lane) {occluded[indices[lane]] = (blocked & 1u << lane) != 0;}
+            });
+    }
+
+    // Evaluate the surface attributes of an intersection found by intersect
+    [[nodiscard]] RaycastHit resolve(const Ray &ray, const Intersection &intersection) const {
+        const Vector3 location = ray.evaluateAt(intersection.distance);
+        switch (intersection.type) {
+            case PrimitiveType::Sphere: {
+                const SpherePrimitive& sphere = spheres[intersection.index];
+                const Vector3 normal = sphere.getNormalAt(location);
+                return {materials[sphere.material], intersection.distance, sphere.projectOnto(normal), normal};
+            }
+            case PrimitiveType::Plane: {
+                const PlanePrimitive& plane = planes[intersection.index];
+                return {materials[plane.material], intersection.distance, location, plane.getNormalAt(location)};
+            }
+            default:
+                return {};
+        }
+    }
+
+    // Find the closest intersection of given ray with an object in the scene
+    [[nodiscard]] RaycastHit findClosestIntersection(const Ray &ray) const {return resolve(ray, intersect(ray));}
 
     [[nodiscard]] ColorRGB getAmbientLighting() const {return ambientLight;}
 
-    void setAmbientLight(ColorRGB ambientLight) {this->ambientLight = ambientLight;}
+    void setAmbientLight(ColorRGB ambientLight) {
+        requireEditable();
+        this->ambientLight = ambientLight;
+    }
+
+    [[nodiscard]] const CameraSettings& getCamera() const {return camera;}
+
+    void setCamera(const CameraSettings& camera) {
+        requireEditable();
+        this->camera = camera;
+    }
+
+    // The lights in their compact form, available once the scene is committed
+    [[nodiscard]] std::span<const LightPrimitive> getLights() const {
+        assert(committed);
+        return lights;
+    }
 
-    [[nodiscard]] PointLight getPointLight() const {return pointLights.front();}
+    // The lights in structure-of-arrays form for batched evaluation, available once the scene is committed
+    [[nodiscard]] const LightSoA& getLightSoA() const {
+        assert(committed);
+        return lightSoA;
+    }
 
-    std::list<PointLight> getPointLights() {return pointLights;}
+    // Hierarchy over the lights for importance sampling them, available once the scene is committed
+    [[nodiscard]] const LightTree& getLightTree() const {
+        assert(committed);
+        return lightTree;
+    }
 
-    void addPointLight(const PointLight &pointLight) {pointLights.push_back(pointLight);}
+    void addPointLight(const PointLight &pointLight) {
+        requireEditable();
+        pointLights.push_back(pointLight);
+    }
 
 };
 
@@ -0,0 +1,206 @@
+#include "SceneFile.h"
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "MappedFile.h"
+
+namespace {
+	constexpr std::array<char, 8> MAGIC = {'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0'};
+	// Reads back as a different value on a machine of the other byte order
+	constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+	constexpr std::uint64_t ALIGNMENT = 64;
+
+	struct Header {
+		std::array<char, 8> magic;
+		std::uint32_t version;
+		std::uint32_t byteOrder;
+		std::uint32_t realSize;
+		std::uint32_t sectionCount;
+		std::uint64_t fileSize;
+		std::array<std::uint8_t, 32> reserved;
+	};
+	static_assert(sizeof(Header) == 64);
+
+	enum class SectionType : std::uint32_t {Settings = 1, Materials, Spheres, Planes, Lights, HierarchyNodes, HierarchyOrder};
+
+	struct Section {
+		SectionType type;
+		std::uint32_t elementSize;
+		std::uint64_t offset;
+		std::uint64_t count;
+	};
+
+	// Everything about the scene that is not an array
+	struct Settings {
+		CameraSettings camera;
+		ColorRGB ambientLight = ColorRGB(0);
+	};
+
+	template <typename T>
+	constexpr bool storable = std::is_trivially_copyable_v<T>;
+	static_assert(storable<Settings> && storable<Material> && storable<SpherePrimitive> && storable<PlanePrimitive> &&
+		storable<LightPrimitive> && storable<BVH::Node>, "scene file sections are copied as raw bytes");
+
+	std::uint64_t alignUp(const std::uint64_t offset) {return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;}
+
+	// The sections of a file being written, laid out one after another after the header and section table
+	class Writer {
+		std::vector<Section> sections;
+		std::vector<std::span<const std::byte>> contents;
+
+	public:
+		template <typename T>
+		void add(const SectionType type, const std::span<const T> elements) {
+			sections.push_back({type, sizeof(T), 0, elements.size()});
+			contents.push_back(std::as_bytes(elements));
+		}
+
+		void write(const std::string& path) {
+			std::uint64_t offset = alignUp(sizeof(Header) + sections.size() * sizeof(Section));
+			for (Section& section : sections) {
+				section.offset = offset;
+				offset = alignUp(offset + section.count * section.elementSize);
+			}
+			Header header{MAGIC, SceneFile::VERSION, BYTE_ORDER_MARK, sizeof(Real),
+				static_cast<std::uint32_t>(sections.size()), offset, {}};
+
+			std::ofstream out(path, std::ios::binary);
+			if (!out) throw std::runtime_error("cannot open " + path + " for writing");
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			out.write(reinterpret_cast<const char*>(sections.data()), static_cast<std::streamsize>(sections.size() * sizeof(Section)));
+			std::uint64_t position = sizeof(Header) + sections.size() * sizeof(Section);
+			constexpr std::array<char, ALIGNMENT> padding{};
+			for (size_t i = 0; i < sections.size(); ++i) {
+				out.write(padding.data(), static_cast<std::streamsize>(sections[i].offset - position));
+				out.write(reinterpret_cast<const char*>(contents[i].data()), static_cast<std::streamsize>(contents[i].size()));
+				position = sections[i].offset + contents[i].size();
+			}
+			out.write(padding.data(), static_cast<std::streamsize>(offset - position));
+			if (!out) throw std::runtime_error("failed writing " + path);
+		}
+	};
+
+	// The checked sections of a mapped file
+	class Reader {
+		const MappedFile& file;
+		const std::string& path;
+		std::span<const Section> sections;
+
+		[[noreturn]] void fail(const std::string& reason) const {throw std::runtime_error(path + ": " + reason);}
+
+	public:
+		Reader(const MappedFile& file, const std::string& path) : file(file), path(path) {
+			Header header{};
+			if (file.getSize() < sizeof(header)) fail("too small to be a scene file");
+			std::memcpy(&header, file.getData(), sizeof(header));
+			if (header.magic != MAGIC) fail("not a scene file");
+			if (header.byteOrder != BYTE_ORDER_MARK) fail("written on a machine of the other byte order");
+			if (header.version != SceneFile::VERSION) {
+				fail("unsupported scene file version " + std::to_string(header.version) + ", expected " +
+					std::to_string(SceneFile::VERSION));
+			}
+			if (header.realSize != sizeof(Real)) {
+				fail(std::string("written in ") + (header.realSize == sizeof(float) ? "single" : "double") +
+					" precision, which this build does not use");
+			}
+			if (header.fileSize != file.getSize()) fail("truncated or has trailing data");
+			if (sizeof(Header) + header.sectionCount * sizeof(Section) > file.getSize()) fail("truncated section table");
+			sections = {reinterpret_cast<const Section*>(file.getData() + sizeof(Header)), header.sectionCount};
+		}
+
+		[[nodiscard]] bool has(const SectionType type) const {
+			for (const Section& section : sections) {
+				if (section.type == type) return true;
+			}
+			return false;
+		}
+
+		// Copy a section into a vector, leaving it empty if the file does not have the section
+		template <typename T>
+		void read(const SectionType type, std::vector<T>& elements) const {
+			elements.clear();
+			for (const Section& section : sections) {
+				if (section.type != type) continue;
+				if (section.elementSize != sizeof(T)) fail("section layout does not match this build");
+				if (section.offset % ALIGNMENT != 0 || section.count > (file.getSize() - section.offset) / sizeof(T) ||
+					section.offset > file.getSize()) {
+					fail("section out of bounds");
+				}
+				// The mapping is page aligned and sections 64 byte aligned, so the elements can be read in place
+				const auto* first = reinterpret_cast<const T*>(file.getData() + section.offset);
+				elements.assign(first, first + section.count);
+				return;
+			}
+		}
+	};
+}
+
+void SceneFile::save(const Scene& scene, const std::string& path, const bool includeHierarchy) {
+	if (!scene.isCommitted()) throw std::logic_error("only a committed scene can be saved");
+	const Settings settings = {scene.camera, scene.ambientLight};
+	Writer writer;
+	writer.add(SectionType::Settings, std::span<const Settings>(&settings, 1));
+	writer.add(SectionType::Materials, std::span<const Material>(scene.materials));
+	writer.add(SectionType::Spheres, std::span<const SpherePrimitive>(scene.spheres));
+	writer.add(SectionType::Planes, std::span<const PlanePrimitive>(scene.planes));
+	writer.add(SectionType::Lights, std::span<const LightPrimitive>(scene.lights));
+	if (includeHierarchy) {
+		writer.add(SectionType::HierarchyNodes, std::span<const BVH::Node>(scene.bvh.getNodes()));
+		writer.add(SectionType::HierarchyOrder, std::span<const std::uint32_t>(scene.bvh.getOrder()));
+	}
+	writer.write(path);
+}
+
+Scene SceneFile::load(const std::string& path, const unsigned threads) {
+	const MappedFile file(path);
+	const Reader reader(file, path);
+
+	Scene scene;
+	std::vector<Settings> settings;
+	reader.read(SectionType::Settings, settings);
+	if (settings.size() != 1) throw std::runtime_error(path + ": missing scene settings");
+	scene.camera = settings.front().camera;
+	try {
+		scene.camera.validate();
+	} catch (const std::invalid_argument& e) {
+		throw std::invalid_argument(path + ": " + e.what());
+	}
+	scene.ambientLight = settings.front().ambientLight;
+	reader.read(SectionType::Materials, scene.materials);
+	reader.read(SectionType::Spheres, scene.spheres);
+	reader.read(SectionType::Planes, scene.planes);
+	reader.read(SectionType::Lights, scene.lights);
+
+	// Every primitive has to refer to a material that exists, or rendering would read out of bounds
+	for (const SpherePrimitive& sphere : scene.spheres) {
+		if (sphere.material >= scene.materials.size()) throw std::runtime_error(path + ": sphere material out of range");
+	}
+	for (const PlanePrimitive& plane : scene.planes) {
+		if (plane.material >= scene.materials.size()) throw std::runtime_error(path + ": plane material out of range");
+	}
+
+	std::vector<BVH::Node> nodes;
+	std::vector<std::uint32_t> order;
+	reader.read(SectionType::HierarchyNodes, nodes);
+	reader.read(SectionType::HierarchyOrder, order);
+	if (!nodes.empty() && order.size() == scene.spheres.size()) {
+		// Traversal trusts the hierarchy completely, so a corrupt one would read out of bounds
+		if (!BVH::isValid(nodes, order, scene.spheres.size())) throw std::runtime_error(path + ": corrupt BVH");
+		scene.bvh.assign(std::move(nodes), std::move(order));
+	} else {
+		scene.buildHierarchy(threads);
+	}
+	scene.finalise();
+	return scene;
+}
+
+bool SceneFile::isSceneFile(const std::string& path) {
+	const std::string extension = EXTENSION;
+	return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
@@ -0,0 +1,38 @@
+#ifndef RAYTRACING_SCENEFILE_H
+#define RAYTRACING_SCENEFILE_H
+#include <cstdint>
+#include <string>
+
+#include "Scene.h"
+
+/*
+ * Versioned binary scene files, holding a committed scene exactly as it sits in memory: materials, sphere and plane
+ * primitives, lights, the camera and optionally the BVH. Loading maps the file and copies each section straight into
+ * the scene's arrays, so there is nothing to parse and, with the BVH included, nothing to build apart from the
+ * small vectorised copies of the spheres and lights.
+ *
+ * The file is a 64 byte header, a table of sections and then the sections, each 64 byte aligned. Sections record
+ * the size of their elements, and files written with a different precision, byte order or structure layout are
+ * rejected rather than misread. Unknown section types are skipped, so later versions can add sections.
+ */
+class SceneFile {
+public:
+	static constexpr std::uint32_t VERSION = 1;
+
+	// Conventional extension, which the command line uses to tell binary scenes from XML ones
+	static constexpr const char* EXTENSION = ".rtscene";
+
+	// Write a committed scene, with its BVH unless includeHierarchy is false, throwing std::runtime_error on failure
+	static void save(const Scene& scene, const std::string& path, bool includeHierarchy = true);
+
+	/*
+	 * Load a scene written by save, committed and ready to render, throwing std::runtime_error if it is not valid, or
+	 * std::invalid_argument if its camera has no view. A file without a BVH has one built on up to the given number
+	 * of threads.
+	 */
+	static Scene load(const std::string& path, unsigned threads = 1);
+
+	[[nodiscard]] static bool isSceneFile(const std::string& path);
+};
+
+#endif //RAYTRACING_SCENEFILE_H
@@ -0,0 +1 @@
+#include "SceneGenerator.h"
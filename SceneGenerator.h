@@ -0,0 +1,192 @@
+#ifndef RAYTRACING_SCENEGENERATOR_H
+#define RAYTRACING_SCENEGENERATOR_H
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "Camera.h"
+#include "ColorRGB.h"
+#include "Plane.h"
+#include "PointLight.h"
+#include "Random.h"
+#include "Scene.h"
+#include "Sphere.h"
+#include "Vector3.h"
+
+/*
+ * Procedural test scenes in the spirit of the Standard Procedural Database, built straight into a Scene rather than
+ * written out as XML. Every generator takes a size, the number of primitives that scales with it, and a seed. The
+ * random numbers come from hashing the seed, so a given size and seed give the same scene on every platform. The
+ * scenes come back uncommitted, each with a camera set up to frame it.
+ */
+namespace SceneGenerator {
+	// Names accepted by generate()
+	constexpr std::array<const char*, 4> NAMES = {"sphereflake", "ball_field", "reflective_grid", "many_light_room"};
+
+	// Uniform values in [0, 1) drawn one after another from a seed
+	class Sequence {
+		std::uint64_t seed;
+		std::uint64_t index = 0;
+
+	public:
+		explicit Sequence(const std::uint64_t seed) : seed(Random::mix(seed)) {}
+
+		Real next() {return Random::toUnit(Random::combine(seed, index++));}
+
+		Real next(const Real low, const Real high) {return low + (high - low) * next();}
+
+		ColorRGB nextColour(const Real low, const Real high) {
+			const Real r = next(low, high), g = next(low, high);
+			return {r, g, next(low, high)};
+		}
+	};
+
+	namespace Detail {
+		// Add the nine children of a sphere of the flake, facing away from it along axis, down to the given depth
+		inline void addFlakeChildren(Scene& scene, const Vector3& centre, const Real radius, const Vector3& axis,
+			const int depth, const ColorRGB& colour) {
+			if (depth == 0) return;
+			const Vector3 u = (std::abs(axis.x) < 0.5 ? Vector3(1, 0, 0) : Vector3(0, 1, 0)).cross(axis).normalised();
+			const Vector3 v = axis.cross(u);
+			const Real childRadius = radius / 3;
+			// Six children around the equator and three above, in the gaps between them
+			for (int i = 0; i < 9; ++i) {
+				const Real angle = i < 6 ? static_cast<Real>(M_PI) / 3 * i : static_cast<Real>(M_PI) / 6 * (4 * (i - 6) + 1);
+				const Real elevation = i < 6 ? 0 : static_cast<Real>(M_PI) / 3;
+				const Vector3 direction = u.scale(std::cos(angle) * std::cos(elevation))
+					.add(v.scale(std::sin(angle) * std::cos(elevation))).add(axis.scale(std::sin(elevation)));
+				const Vector3 child = centre.add(direction.scale(radius + childRadius));
+				scene.addObject(Sphere(child, childRadius, colour, 0.6, 0.8, 20, 0.5, 0));
+				addFlakeChildren(scene, child, childRadius, direction, depth - 1, colour);
+			}
+		}
+	}
+
+	/*
+	 * The sphereflake: a sphere with nine spheres a third of its size around it, each with nine more, and so on.
+	 * The flake is as many levels deep as fits in size spheres, so the count goes 1, 10, 91, 820, 7381... The seed
+	 * tilts the flake and picks its colour.
+	 */
+	inline Scene sphereflake(const std::size_t size, const std::uint32_t seed) {
+		Sequence random(seed);
+		int depth = 0;
+		for (std::size_t count = 1, level = 1; count + level * 9 <= size; level *= 9, count += level) {depth++;}
+
+		Scene scene;
+		const Vector3 axis = Vector3(random.next(-0.3, 0.3), 1, random.next(-0.3, 0.3)).normalised();
+		const ColorRGB colour = random.nextColour(0.4, 1);
+		scene.addObject(Plane(Vector3(0, -1.5, 0), Vector3(0, 1, 0), ColorRGB(0.6), 0.8, 0.2, 10, 0.1));
+		scene.addObject(Sphere(Vector3(0), 1, colour, 0.6, 0.8, 20, 0.5, 0));
+		Detail::addFlakeChildren(scene, Vector3(0), 1, axis, depth, colour);
+
+		scene.addPointLight(PointLight(Vector3(-4, 6, -3), ColorRGB(1), 400));
+		scene.addPointLight(PointLight(Vector3(5, 4, -4), ColorRGB(1, 0.9, 0.8), 250));
+		scene.addPointLight(PointLight(Vector3(0, 8, 4), ColorRGB(0.8, 0.9, 1), 200));
+		scene.setAmbientLight(ColorRGB(0.05));
+		CameraSettings camera;
+		camera.position = Vector3(0, 1.5, -5.5);
+		camera.lookAt = Vector3(0, 0.2, 0);
+		camera.fov = 50;
+		scene.setCamera(camera);
+		return scene;
+	}
+
+	// A box of size randomly placed, randomly coloured spheres over a floor, spread out so the density stays the same
+	inline Scene ballField(const std::size_t size, const std::uint32_t seed) {
+		Sequence random(seed);
+		const Real extent = 10 * std::cbrt(static_cast<Real>(std::max<std::size_t>(size, 1)));
+		const Real radius = 2;
+
+		Scene scene;
+		scene.addObject(Plane(Vector3(0, -extent - radius, 0), Vector3(0, 1, 0), ColorRGB(0.8)));
+		for (std::size_t i = 0; i < size; ++i) {
+			const Vector3 centre(random.next(-extent, extent), random.next(-extent, extent), random.next(2, 4) * extent);
+			scene.addObject(Sphere(centre, radius, random.nextColour(0, 1)));
+		}
+		for (int i = 0; i < 4; ++i) {
+			const Vector3 position(random.next(-extent, extent), 2 * extent, random.next(1, 3) * extent);
+			scene.addPointLight(PointLight(position, ColorRGB(1), 200 * extent * extent));
+		}
+		scene.setAmbientLight(ColorRGB(0.05));
+		CameraSettings camera;
+		camera.lookAt = Vector3(0, 0, 3 * extent);
+		camera.fov = 45;
+		scene.setCamera(camera);
+		return scene;
+	}
+
+	// A square grid of size mirror-like spheres resting on a plane, with the seed varying their colours
+	inline Scene reflectiveGrid(const std::size_t size, const std::uint32_t seed) {
+		Sequence random(seed);
+		const auto side = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<Real>(std::max<std::size_t>(size, 1)))));
+		const Real spacing = 3, half = spacing * static_cast<Real>(side - 1) / 2;
+
+		Scene scene;
+		scene.addObject(Plane(Vector3(0), Vector3(0, 1, 0), ColorRGB(0.7), 0.8, 0.3, 10, 0.2));
+		for (std::size_t i = 0; i < size; ++i) {
+			const Vector3 centre(spacing * static_cast<Real>(i % side) - half, 1, spacing * static_cast<Real>(i / side) - half);
+			scene.addObject(Sphere(centre, 1, random.nextColour(0.2, 0.9), 0.4, 1, 50, 0.8, 0));
+		}
+		const Real height = std::max(static_cast<Real>(10), half);
+		scene.addPointLight(PointLight(Vector3(-half, height, -half), ColorRGB(1), 40 * height * height));
+		scene.addPointLight(PointLight(Vector3(half, height, half), ColorRGB(1), 40 * height * height));
+		scene.setAmbientLight(ColorRGB(0.05));
+		CameraSettings camera;
+		camera.position = Vector3(0, half + 6, -2 * half - 10);
+		camera.lookAt = Vector3(0);
+		camera.fov = 45;
+		scene.setCamera(camera);
+		return scene;
+	}
+
+	/*
+	 * A closed room lit by size dim point lights scattered through it, above a few spheres on the floor. The total
+	 * power of the lights stays the same whatever their number.
+	 */
+	inline Scene manyLightRoom(const std::size_t size, const std::uint32_t seed) {
+		Sequence random(seed);
+		const Real width = 20, height = 10, depth = 30;
+
+		Scene scene;
+		scene.addObject(Plane(Vector3(0), Vector3(0, 1, 0), ColorRGB(0.8)));
+		scene.addObject(Plane(Vector3(0, height, 0), Vector3(0, -1, 0), ColorRGB(0.8)));
+		scene.addObject(Plane(Vector3(0, 0, depth), Vector3(0, 0, -1), ColorRGB(0.7, 0.7, 0.8)));
+		scene.addObject(Plane(Vector3(-width / 2, 0, 0), Vector3(1, 0, 0), ColorRGB(0.8, 0.4, 0.4)));
+		scene.addObject(Plane(Vector3(width / 2, 0, 0), Vector3(-1, 0, 0), ColorRGB(0.4, 0.8, 0.4)));
+		for (int i = 0; i < 12; ++i) {
+			const Real radius = random.next(0.5, 1.5);
+			const Vector3 centre(random.next(-width / 2 + 2, width / 2 - 2), radius, random.next(8, depth - 2));
+			scene.addObject(Sphere(centre, radius, random.nextColour(0.3, 1)));
+		}
+		const Real intensity = 1500 / static_cast<Real>(std::max<std::size_t>(size, 1));
+		for (std::size_t i = 0; i < size; ++i) {
+			const Vector3 position(random.next(-width / 2, width / 2), random.next(0.5, height - 0.5),
+				random.next(2, depth));
+			scene.addPointLight(PointLight(position, random.nextColour(0.5, 1), intensity));
+		}
+		scene.setAmbientLight(ColorRGB(0.02));
+		CameraSettings camera;
+		camera.position = Vector3(0, height / 2, 0.5);
+		camera.lookAt = Vector3(0, height / 3, depth);
+		camera.fov = 70;
+		scene.setCamera(camera);
+		return scene;
+	}
+
+	// Generate a scene by name, one of NAMES
+	inline Scene generate(const std::string& name, const std::size_t size, const std::uint32_t seed) {
+		if (name == "sphereflake") return sphereflake(size, seed);
+		if (name == "ball_field") return ballField(size, seed);
+		if (name == "reflective_grid") return reflectiveGrid(size, seed);
+		if (name == "many_light_room") return manyLightRoom(size, seed);
+		std::string names;
+		for (const char* known : NAMES) {names += names.empty() ? known : std::string(", ") + known;}
+		throw std::invalid_argument("unknown scene generator '" + name + "', expected one of " + names);
+	}
+}
+
+#endif //RAYTRACING_SCENEGENERATOR_H
@@ -4,134 +4,341 @@
 
 #ifndef RAYTRACING_SCENELOADER_H
 #define RAYTRACING_SCENELOADER_H
-#include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
 
+#include "Camera.h"
+#include "MappedFile.h"
 #include "Plane.h"
+#include "PointLight.h"
 #include "Scene.h"
 #include "Sphere.h"
 #include "tinyxml2-11.0.0/tinyxml2.h"
 
+/*
+ * Loads our scene from an XML file: a <scene> element holding <sphere>, <plane>, <point-light>, <ambient-light> and
+ * <camera> elements. The document is visited once, and each element's attributes are converted with std::from_chars
+ * and added straight to the scene. Missing attributes take their defaults, while malformed ones and unknown
+ * elements are errors, reported with the line they are on.
+ *
+ * Given more than one thread, a large file is split at element boundaries inside <scene> and the chunks are parsed
+ * at the same time, each into a scene of its own. The calling thread merges them in file order as they finish, so
+ * the result is the same as parsing on one thread, and the BVH is then built on the same number of threads. If any
+ * chunk fails to parse, the whole file is parsed again on one thread to report the error exactly as it would be.
+ */
 class SceneLoader {
-	// Loads our scene from an XML file
-	Scene *scene;
-	static Vector3 getPosition(const tinyxml2::XMLElement& tag) {
-		double x = getDouble(tag, "x", 0);
-		double y = getDouble(tag, "y", 0);
-		double z = getDouble(tag, "z", 0);
-		return {x, y, z};
+	// Files smaller than this are parsed on one thread, splitting them would cost more than it saves
+	static constexpr std::size_t PARALLEL_MIN_SIZE = 1 << 20;
+	// Largest chunk a file is split into, so memory use stays bounded on very large files
+	static constexpr std::size_t MAX_CHUNK_SIZE = 16 << 20;
+
+	// Adds every element below <scene> to the scene as it is visited
+	class Visitor : public tinyxml2::XMLVisitor {
+		Scene& scene;
+		const std::string& source;
+		// Whether the document is a chunk from inside <scene>, with the objects at the top level
+		const bool fragment;
+		bool visitedScene = false;
+
+	public:
+		// Whether a camera or ambient light element was visited, which a chunk has to pass on when it is merged
+		bool setsCamera = false, setsAmbientLight = false;
+
+		Visitor(Scene& scene, const std::string& source, const bool fragment) : scene(scene), source(source),
+			fragment(fragment) {}
+
+		bool VisitEnter(const tinyxml2::XMLElement& element, const tinyxml2::XMLAttribute*) override {
+			const std::string_view name = element.Name();
+			if (!fragment && element.Parent()->ToDocument() != nullptr) {
+				if (name != "scene") throw error(source, element, "scene file does not contain a scene element");
+				visitedScene = true;
+				return true;
+			}
+			if (name == "sphere") {
+				scene.addObject(Sphere(getPosition(source, element), getReal(source, element, "radius", 1),
+					getColour(source, element, ColorRGB(1)), getReal(source, element, "kD", 0.8),
+					getReal(source, element, "kS", 1.2), getReal(source, element, "alphaS", 10),
+					getReal(source, element, "reflectivity", 0.3), getTransmittance(source, element)));
+			} else if (name == "plane") {
+				scene.addObject(Plane(getPosition(source, element), getNormal(source, element),
+					getColour(source, element, ColorRGB(1)), getReal(source, element, "kD", 0.8),
+					getReal(source, element, "kS", 1.2), getReal(source, element, "alphaS", 10),
+					getReal(source, element, "reflectivity", 0.3)));
+			} else if (name == "point-light") {
+				scene.addPointLight(PointLight(getPosition(source, element), getColour(source, element, ColorRGB(1)),
+					getReal(source, element, "intensity", 100)));
+			} else if (name == "camera") {
+				CameraSettings camera;
+				camera.position = getPosition(source, element);
+				camera.lookAt = getVector(source, element, "lx", "ly", "lz", camera.lookAt);
+				camera.up = getVector(source, element, "ux", "uy", "uz", camera.up);
+				camera.fov = getReal(source, element, "fov", CameraSettings::DEFAULT_FOV);
+				camera.aspectRatio = getReal(source, element, "aspect", 0);
+				try {
+					camera.validate();
+				} catch (const std::invalid_argument& e) {
+					throw std::invalid_argument(source + ":" + std::to_string(element.GetLineNum()) + ": " + e.what());
+				}
+				scene.setCamera(camera);
+				setsCamera = true;
+			} else if (name == "ambient-light") {
+				scene.setAmbientLight(getColour(source, element, ColorRGB(1))
+					.scale(getReal(source, element, "intensity", 1)));
+				setsAmbientLight = true;
+			} else {
+				throw error(source, element, "unknown object tag: " + std::string(name));
+			}
+			// Objects have no children in the schema
+			return false;
+		}
+
+		bool VisitExit(const tinyxml2::XMLDocument&) override {
+			if (!fragment && !visitedScene) throw std::runtime_error(source + ": scene file is empty");
+			return true;
+		}
+	};
+
+	// A run of whole elements from inside <scene>, parsed on its own
+	struct Chunk {
+		std::string_view text;
+		Scene scene;
+		bool setsCamera = false, setsAmbientLight = false, failed = false;
+		std::atomic<bool> parsed = false;
+	};
+
+	Scene scene;
+
+	static std::runtime_error error(const std::string& source, const tinyxml2::XMLElement& tag,
+		const std::string& message) {
+		return std::runtime_error(source + ":" + std::to_string(tag.GetLineNum()) + ": " + message);
 	}
 
-	static Vector3 getNormal(const tinyxml2::XMLElement& tag) {
-		double x = getDouble(tag, "nx", 0);
-		double y = getDouble(tag, "ny", 0);
-		double z = getDouble(tag, "nz", 0);
-		const Vector3 n = {x, y, z};
-		return n.normalised();
+	static std::runtime_error invalidAttribute(const std::string& source, const tinyxml2::XMLElement& tag,
+		const char* attribute, const char* value) {
+		return error(source, tag, "invalid " + std::string(attribute) + " '" + value + "' on " + tag.Name());
 	}
 
-	static ColorRGB getColour(const tinyxml2::XMLElement& tag) {
-		const std::string hexString = tag.Attribute("colour");
-		double red = stoi(hexString.substr(1, 3), nullptr,16) / 255.0;
-		double green = stoi(hexString.substr(3, 5), nullptr,16) / 255.0;
-		double blue = stoi(hexString.substr(5, 7), nullptr,16) / 255.0;
-		return {red, green, blue};
+	static Real getReal(const std::string& source, const tinyxml2::XMLElement& tag, const char* attribute,
+		const Real fallback) {
+		const char* value = tag.Attribute(attribute);
+		if (value == nullptr) return fallback;
+		const char* end = value + std::strlen(value);
+		// from_chars takes no leading plus sign
+		const char* start = *value == '+' ? value + 1 : value;
+		Real number = 0;
+		const auto [last, result] = std::from_chars(start, end, number);
+		if (result != std::errc() || last != end) throw invalidAttribute(source, tag, attribute, value);
+		return number;
 	}
 
-	static ColorRGB getTransmittance(const tinyxml2::XMLElement& tag) {
-		double tr = getDouble(tag, "tr", 0);
-		double tg = getDouble(tag, "tg", 0);
-		double tb = getDouble(tag, "tb", 0);
-		return {tr, tg, tb};
+	// A point or direction given by three attributes, each defaulting to the matching component of fallback
+	static Vector3 getVector(const std::string& source, const tinyxml2::XMLElement& tag, const char* x, const char* y,
+		const char* z, const Vector3& fallback) {
+		return {getReal(source, tag, x, fallback.x), getReal(source, tag, y, fallback.y),
+			getReal(source, tag, z, fallback.z)};
 	}
 
+	static Vector3 getPosition(const std::string& source, const tinyxml2::XMLElement& tag) {
+		return getVector(source, tag, "x", "y", "z", Vector3(0));
+	}
 
-	static double getDouble(const tinyxml2::XMLElement& tag, const std::string& attribute, const double fallback) {
-			return std::stod(tag.Attribute(attribute.c_str())); //will return 0 or something on failure.
+	static Vector3 getNormal(const std::string& source, const tinyxml2::XMLElement& tag) {
+		return getVector(source, tag, "nx", "ny", "nz", Vector3(0)).normalised();
 	}
 
-	static std::string getString(const tinyxml2::XMLElement &tag, const std::string& attribute){return tag.Attribute(attribute.c_str());}
+	static ColorRGB getTransmittance(const std::string& source, const tinyxml2::XMLElement& tag) {
+		const Vector3 t = getVector(source, tag, "tr", "tg", "tb", Vector3(0));
+		return {t.x, t.y, t.z};
+	}
 
-public:
-	explicit SceneLoader(const std::string& filename) {
-		scene = new Scene();
-
-		tinyxml2::XMLElement document{};
-		try {
-			document = DocumentBuilderFactory.newInstance().newDocumentBuilder().parse(new File(filename))
-					.getDocumentElement();
-		} catch (ParserConfigurationException e) {
-			assert(false);
-		} catch (IOException e) {
-			throw new RuntimeException("error reading file:\n" + e.getMessage());
-		} catch (SAXException e) {
-			throw new RuntimeException("error loading XML.");
+	// A colour written as #rrggbb, each channel read as two hex digits
+	static ColorRGB getColour(const std::string& source, const tinyxml2::XMLElement& tag, const ColorRGB& fallback) {
+		const char* value = tag.Attribute("colour");
+		if (value == nullptr) return fallback;
+		if (value[0] != '#' || std::strlen(value) != 7) throw invalidAttribute(source, tag, "colour", value);
+		Real channels[3];
+		for (int i = 0; i < 3; ++i) {
+			const char* digits = value + 1 + 2 * i;
+			unsigned byte = 0;
+			const auto [last, result] = std::from_chars(digits, digits + 2, byte, 16);
+			if (result != std::errc() || last != digits + 2) throw invalidAttribute(source, tag, "colour", value);
+			channels[i] = static_cast<Real>(byte) / 255;
 		}
+		return {channels[0], channels[1], channels[2]};
+	}
 
-		if (!document.getNodeName().equals("scene"))
-			throw new RuntimeException("scene file does not contain a scene element");
-
-		NodeList elements = document.getElementsByTagName("*");
-		for (int i = 0; i < elements.getLength(); ++i) {
-			tinyxml2::XMLElement element = (tinyxml2::XMLElement) elements.item(i);
-			switch (element.getNodeName()) {
-			case "sphere":
-				Sphere sphere = {
-				getPosition(element), getDouble(element, "radius", 1), getColour(element),
-	   getDouble(element, "kD", 0.8), getDouble(element, "kS", 1.2),
-	   getDouble(element, "alphaS", 10), getDouble(element, "reflectivity", 0.3),
-	   getTransmittance(element)};
-				scene->addObject(sphere);
-				break;
-
-		/*	case "cone":
-				Cone cone = new Cone(getPosition(element), getDouble(element, "radius", 1), getDouble(element, "height", 1), getColour(element),
-						getDouble(element, "kD", 0.8), getDouble(element, "kS", 1.2),
-						getDouble(element, "alphaS", 10), getDouble(element, "reflectivity", 0.3)
-				);
-				scene.addObject(cone);
-				break;
-
-			case "cylinder":
-					Cylinder cylinder = new Cylinder(getPosition(element), getDouble(element, "radius", 1), getDouble(element, "height", 1), getColour(element),
-							getDouble(element, "kD", 0.8), getDouble(element, "kS", 1.2),
-							getDouble(element, "alphaS", 10), getDouble(element, "reflectivity", 0.3)
-					);
-					scene.addObject(cylinder);
-					break;
-
-			case "bumpy-sphere":
-				BumpySphere bumpySphere = new BumpySphere(getPosition(element), getDouble(element, "radius", 1), getColour(element), getString(element, "bump-map"));
-				scene.addObject(bumpySphere);
-				break;*/
-
-			case "plane":
-				Plane plane = {
-				getPosition(element), getNormal(element), getColour(element),
-		 getDouble(element, "kD", 0.8), getDouble(element, "kS", 1.2),
-		 getDouble(element, "alphaS", 10), getDouble(element, "reflectivity", 0.3)};
-				scene->addObject(plane);
-				break;
-
-			case "point-light":
-				PointLight light = {
-				getPosition(element), getColour(element),getDouble(element, "intensity", 100)};
-				scene->addPointLight(light);
-				break;
-
-			case "ambient-light":
-				scene->setAmbientLight(getColour(element).scale(getDouble(element, "intensity", 1)));
-				break;
-
-			default:
-				throw new RuntimeException("unknown object tag: " + element.getNodeName());
+	static void parse(const std::string_view xml, const std::string& source, Visitor& visitor) {
+		tinyxml2::XMLDocument document;
+		if (document.Parse(xml.data(), xml.size()) != tinyxml2::XML_SUCCESS) {
+			throw std::runtime_error(source + ":" + std::to_string(document.ErrorLineNum()) + ": error loading XML: " +
+				document.ErrorStr());
+		}
+		document.Accept(&visitor);
+	}
+
+	// End of the tag starting at position at, skipping over any '>' in quoted attribute values
+	static std::size_t findTagEnd(const std::string_view xml, std::size_t at) {
+		for (char quote = 0; at < xml.size(); ++at) {
+			if (quote != 0) {
+				if (xml[at] == quote) quote = 0;
+			} else if (xml[at] == '"' || xml[at] == '\'') {
+				quote = xml[at];
+			} else if (xml[at] == '>') {
+				return at;
 			}
 		}
+		return std::string_view::npos;
+	}
+
+	/*
+	 * The text between the start and end tags of <scene>, found without parsing the rest of the file. Nothing if the
+	 * file is anything other than a declaration and comments followed by a non-empty <scene>, such files being left
+	 * to the ordinary parse.
+	 */
+	static std::optional<std::string_view> findBody(const std::string_view xml) {
+		constexpr const char* SPACE = " \t\r\n";
+		std::size_t at = 0;
+		while ((at = xml.find_first_not_of(SPACE, at)) != std::string_view::npos) {
+			std::string_view terminator;
+			if (xml.substr(at, 2) == "<?") terminator = "?>";
+			else if (xml.substr(at, 4) == "<!--") terminator = "-->";
+			else break;
+			at = xml.find(terminator, at);
+			if (at == std::string_view::npos) return {};
+			at += terminator.size();
+		}
+		if (at == std::string_view::npos || xml.substr(at, 6) != "<scene" || at + 6 >= xml.size() ||
+			std::string_view(" \t\r\n>").find(xml[at + 6]) == std::string_view::npos) {
+			return {};
+		}
+		const std::size_t start = findTagEnd(xml, at);
+		const std::size_t end = xml.rfind("</scene");
+		if (start == std::string_view::npos || xml[start - 1] == '/' || end == std::string_view::npos || end < start) {
+			return {};
+		}
+		// Nothing but white space may follow the end tag
+		const std::size_t close = xml.find_first_not_of(SPACE, end + 7);
+		if (close == std::string_view::npos || xml[close] != '>' ||
+			xml.find_first_not_of(SPACE, close + 1) != std::string_view::npos) {
+			return {};
+		}
+		return xml.substr(start + 1, end - start - 1);
+	}
+
+	/*
+	 * Split the body of the scene into about count chunks, each starting at a '<' followed by a name. A split can
+	 * land inside a comment, or anywhere else that is not the start of an element, only by leaving the chunk before
+	 * it unterminated, so such splits show up as parse errors rather than changing the scene.
+	 */
+	static std::vector<std::string_view> split(const std::string_view body, const std::size_t count) {
+		std::vector<std::string_view> chunks;
+		std::size_t start = 0;
+		for (std::size_t i = 1; i < count; ++i) {
+			std::size_t end = std::max(start + 1, body.size() / count * i);
+			while ((end = body.find('<', end)) != std::string_view::npos && end + 1 < body.size() &&
+				!std::isalpha(static_cast<unsigned char>(body[end + 1])) && body[end + 1] != '_') {
+				end++;
+			}
+			if (end == std::string_view::npos || end + 1 >= body.size()) break;
+			chunks.push_back(body.substr(start, end - start));
+			start = end;
+		}
+		chunks.push_back(body.substr(start));
+		return chunks;
+	}
+
+	/*
+	 * Parse the chunks of the body on the given number of threads, the calling thread merging them into the scene in
+	 * file order while the others carry on parsing, and helping to parse whenever the next chunk is not ready.
+	 * Returns false if the file could not be split or a chunk failed to parse, leaving the scene part-filled.
+	 */
+	bool loadChunks(const std::string_view xml, const std::string& source, const unsigned threads) {
+		const std::optional<std::string_view> body = findBody(xml);
+		if (!body) return false;
+		const std::vector<std::string_view> texts = split(*body, std::max<std::size_t>(4 * threads,
+			body->size() / MAX_CHUNK_SIZE + 1));
+		if (texts.size() < 2) return false;
+
+		std::vector<Chunk> chunks(texts.size());
+		for (std::size_t i = 0; i < texts.size(); ++i) {chunks[i].text = texts[i];}
+		std::atomic<std::size_t> next = 0;
+		std::atomic<bool> failed = false;
+		// Take the next chunk and parse it, unless one has already failed, returning false once none are left
+		auto parseNext = [&] {
+			const std::size_t index = next++;
+			if (index >= chunks.size()) return false;
+			Chunk& chunk = chunks[index];
+			if (!failed) {
+				try {
+					Visitor visitor(chunk.scene, source, true);
+					parse(chunk.text, source, visitor);
+					chunk.setsCamera = visitor.setsCamera;
+					chunk.setsAmbientLight = visitor.setsAmbientLight;
+				} catch (const std::exception&) {
+					chunk.failed = true;
+					failed = true;
+				}
+			} else {
+				chunk.failed = true;
+			}
+			chunk.parsed = true;
+			chunk.parsed.notify_one();
+			return true;
+		};
+
+		// Joined on leaving, even if merging throws
+		std::vector<std::jthread> pool;
+		for (unsigned i = 1; i < threads; ++i) {pool.emplace_back([&] {while (parseNext()) {}});}
+		for (Chunk& chunk : chunks) {
+			while (!chunk.parsed && parseNext()) {}
+			chunk.parsed.wait(false);
+			if (chunk.failed) break;
+			if (chunk.setsCamera) scene.setCamera(chunk.scene.getCamera());
+			if (chunk.setsAmbientLight) scene.setAmbientLight(chunk.scene.getAmbientLighting());
+			scene.append(std::move(chunk.scene));
+		}
+		return !failed;
+	}
+
+	void load(const std::string_view xml, const std::string& source, const unsigned threads) {
+		if (threads < 2 || xml.size() < PARALLEL_MIN_SIZE || !loadChunks(xml, source, threads)) {
+			scene = Scene();
+			Visitor visitor(scene, source, false);
+			parse(xml, source, visitor);
+		}
+		scene.commit(threads);
+	}
+
+public:
+	/*
+	 * Load and commit the scene in the given file on up to the given number of threads, throwing std::runtime_error if
+	 * it cannot be read or is invalid, or std::invalid_argument if its camera has no view
+	 */
+	explicit SceneLoader(const std::string& filename, const unsigned threads = 1) {
+		const MappedFile file(filename);
+		load(std::string_view(reinterpret_cast<const char*>(file.getData()), file.getSize()), filename, threads);
+	}
+
+	// Load the scene from XML already in memory, with source naming it in error messages
+	SceneLoader(const std::string_view xml, const std::string& source, const unsigned threads = 1) {
+		load(xml, source, threads);
 	}
 
-	[[nodiscard]] Scene getScene() const {return *scene;}
+	[[nodiscard]] const Scene& getScene() const& {return scene;}
 
+	// Take the scene from a loader that is no longer needed, without copying it
+	[[nodiscard]] Scene getScene() && {return std::move(scene);}
 };
 
 
-#endif //RAYTRACING_SCENELOADER_H
\ No newline at end of file
+#endif //RAYTRACING_SCENELOADER_H
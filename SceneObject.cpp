@@ -2,4 +2,20 @@
 // Created by adyan on 03/12/2025.
 //
 
-#include "SceneObject.h"
\ No newline at end of file
+#include "SceneObject.h"
+
+#include "RaycastHit.h"
+
+// The base object has no surface, so it has no normal
+Vector3 SceneObject::getNormalAt(const Vector3& position) const {return NO_COLLISION_VEC;}
+
+RaycastHit SceneObject::surfaceAt(const Ray& ray, const Real distance) const {
+    const Vector3 location = ray.evaluateAt(distance);
+    return {material, distance, location, getNormalAt(location)};
+}
+
+RaycastHit SceneObject::intersectionWith(const Ray& ray) const {
+    const Real distance = intersectDistance(ray);
+    if (distance == NO_INTERSECTION) return {};
+    return surfaceAt(ray, distance);
+}
@@ -4,63 +4,61 @@
 
 #ifndef RAYTRACING_SCENEOBJECT_H
 #define RAYTRACING_SCENEOBJECT_H
+#include "AABB.h"
 #include "ColorRGB.h"
+#include "Material.h"
 #include "Ray.h"
+#include <limits>
 class RaycastHit;
-class SceneObject {
-// The diffuse colour of the object
-protected:
-    ColorRGB colour;
 
-    // Coefficients for calculating Phong illumination
-    double phong_kD, phong_kS, phong_alpha;
+// Distance returned by intersectDistance when a ray misses
+inline constexpr Real NO_INTERSECTION = std::numeric_limits<Real>::infinity();
 
-    // How reflective this object is
-    double reflectivity;
+class SceneObject {
+// The surface properties of the object
+protected:
+    Material material;
 
-    // How much light is transmitted through the object (between 0 and 1)
-    ColorRGB transmittance;
-    double refractive_index;
+    SceneObject() = default;
 
-    SceneObject() :
-        colour(1),phong_kD(0),phong_kS(0),phong_alpha(0),reflectivity(0),transmittance(0),
-        refractive_index(1.5) {}
+    SceneObject(const ColorRGB& colour, Real phong_kD, Real phong_kS, Real phong_alpha, Real reflectivity) :
+    material(colour, phong_kD, phong_kS, phong_alpha, reflectivity, 0) {}
 
-    SceneObject(const ColorRGB& colour, double phong_kD, double phong_kS, double phong_alpha, double reflectivity) :
-    colour(colour), phong_alpha(phong_alpha), phong_kD(phong_kD), phong_kS(phong_kS), reflectivity(reflectivity),
-    transmittance(0), refractive_index(1.5) {}
+    SceneObject(const ColorRGB& colour, Real phong_kD, Real phong_kS, Real phong_alpha, Real reflectivity, Real transmittance) :
+    material(colour, phong_kD, phong_kS, phong_alpha, reflectivity, transmittance) {}
 
-    SceneObject(const ColorRGB& colour, double phong_kD, double phong_kS, double phong_alpha, double reflectivity, double transmittance) :
-    colour(colour), phong_alpha(phong_alpha), phong_kD(phong_kD), phong_kS(phong_kS), reflectivity(reflectivity),
-    transmittance(transmittance), refractive_index(1.5) {}
+    SceneObject(const ColorRGB& colour, Real phong_kD, Real phong_kS, Real phong_alpha, Real reflectivity,
+        const ColorRGB& transmittance) :
+    material(colour, phong_kD, phong_kS, phong_alpha, reflectivity, transmittance) {}
 
     // Intersect this object with ray
 public:
     virtual ~SceneObject() = default;
 
-    virtual RaycastHit* intersectionWith(Ray ray);
+    // Distance along the ray to the first intersection, or NO_INTERSECTION if the ray misses
+    [[nodiscard]] virtual Real intersectDistance(const Ray& ray) const {return NO_INTERSECTION;}
 
-    // Get normal to object at position
-    virtual Vector3 getNormalAt(Vector3 position);
-
-    [[nodiscard]] ColorRGB getColour() const {return colour;}
+    // Surface attributes of the hit at the given distance along the ray, only computed for the closest hit
+    [[nodiscard]] RaycastHit surfaceAt(const Ray& ray, Real distance) const;
 
-    void setColour(const ColorRGB& colour) {this->colour = colour;}
+    // Full intersection, combining intersectDistance and surfaceAt
+    [[nodiscard]] RaycastHit intersectionWith(const Ray& ray) const;
 
-    [[nodiscard]] double getPhong_kD() const {return phong_kD;}
+    // Get normal to object at position
+    [[nodiscard]] virtual Vector3 getNormalAt(const Vector3& position) const;
 
-    [[nodiscard]] double getPhong_kS() const {return phong_kS;}
+    // Get the bounding box of the object, unbounded objects such as planes cover all of space
+    [[nodiscard]] virtual AABB getBounds() const {return AABB::everything();}
 
-    [[nodiscard]] double getPhong_alpha() const {return phong_alpha;}
+    [[nodiscard]] const Material& getMaterial() const {return material;}
 
-    [[nodiscard]] double getReflectivity() const {return reflectivity;}
+    [[nodiscard]] ColorRGB getColour() const {return material.getColour();}
 
-    [[nodiscard]] bool isTransmissive() const {return !transmittance.isZero();}
+    void setColour(const ColorRGB& colour) {material.setColour(colour);}
 
-    [[nodiscard]] ColorRGB getTransmittance() const { return transmittance; }
-    [[nodiscard]] double getRefractiveIndex() const {return refractive_index;}
+    [[nodiscard]] Real getReflectivity() const {return material.getReflectivity();}
 
-    void setReflectivity(double reflectivity) {this->reflectivity = reflectivity;}
+    void setReflectivity(Real reflectivity) {material.setReflectivity(reflectivity);}
 };
 
 
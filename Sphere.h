@@ -4,64 +4,106 @@
 
 #ifndef RAYTRACING_SPHERE_H
 #define RAYTRACING_SPHERE_H
-#include "RaycastHit.h"
+#include <cmath>
+#include <cstdint>
+
 #include "SceneObject.h"
 
 // Phong's reflection model coefficients
-static double SPHERE_KD = 0.8;
-static double SPHERE_KS = 1.2;
-static double SPHERE_ALPHA = 10;
-static double SPHERE_REFLECTIVITY = 0.3;
+static Real SPHERE_KD = 0.8;
+static Real SPHERE_KS = 1.2;
+static Real SPHERE_ALPHA = 10;
+static Real SPHERE_REFLECTIVITY = 0.3;
+
+// Compact sphere geometry stored contiguously by the scene, with its material referenced by index
+struct SpherePrimitive {
+	Vector3 position;
+	Real radius;
+	std::uint32_t material;
+	// Derived from the radius by precompute()
+	Real radiusSquared = 0;
+	Real invRadius = 0;
+
+	// Fill in the values derived from the radius, which every query relies on
+	void precompute() {
+		radiusSquared = radius * radius;
+		invRadius = 1 / radius;
+	}
+
+	/*
+	 * Calculate the distance along the ray to the sphere, or infinity if it is missed. If the ray starts inside
+	 * the sphere, intersection with the surface is also found.
+	 */
+	[[nodiscard]] Real intersectDistance(const Ray& ray) const {
+
+		// Get ray parameters
+		const Vector3 O = ray.getOrigin();
+		const Vector3 D = ray.getDirection();
+
+		// Calculate quadratic coefficients
+		const Real a = D.dot(D);
+		const Real b = 2 * D.dot(O.subtract(position));
+		const Real c = O.subtract(position).dot(O.subtract(position)) - radiusSquared;
+		Real disc = b * b - 4 * a * c;
+		Real sol1 = 0;
+		Real sol2 = 0;
+		Real sol = 0;
+		if (disc > 0) {
+		    sol1 = (-1 * b + std::sqrt(disc)) / (2 * a);
+		    sol2 = (-1 * b - std::sqrt(disc)) / (2 * a);
+		} else if (disc == 0) { sol = -1 * b/ (2 * a); }
+		if (disc < 0 || (sol1 < 0 && sol2 < 0) || (disc == 0 && sol < 0)) { return NO_INTERSECTION; }
+		if (disc == 0 && sol > 0) {return sol;}
+		if ((sol1 > 0 && sol2 < 0) || (sol1 > 0 && sol2 > 0 && sol1 < sol2)) {return sol1;}
+		if ((sol2 > 0 && sol1 < 0) || (sol1 > 0 && sol2 > 0 && sol1 > sol2)) {return sol2;}
+		return NO_INTERSECTION;
+	}
+
+	// Get the unit normal to the surface at a location on it
+	[[nodiscard]] Vector3 getNormalAt(const Vector3& location) const {return location.subtract(position).normalised();}
+
+	/*
+	 * The point on the surface with unit normal N. A hit location evaluated along a ray carries the rounding error of
+	 * the solved distance, which grows with the squared distance to the ray origin over the radius and in single
+	 * precision leaves the point visibly off the surface; snapping it back makes its error that of the position alone.
+	 */
+	[[nodiscard]] Vector3 projectOnto(const Vector3& N) const {return position.add(N.scale(radius));}
+
+	[[nodiscard]] AABB getBounds() const {return {position.subtract(radius), position.add(radius)};}
+};
 
-class Sphere : public SceneObject {
+class Sphere final : public SceneObject {
 	// The radius of the sphere in world units
-	double radius;
+	Real radius;
 	// The world-space position of the sphere
-protected: Vector3 position;
+	Vector3 position;
 public:
 	[[nodiscard]] Vector3 getPosition() const {return position;}
-	Sphere(const Vector3 &position, double radius, const ColorRGB &colour) : SceneObject(colour, SPHERE_KD,
+
+	[[nodiscard]] Real getRadius() const {return radius;}
+
+	Sphere(const Vector3 &position, Real radius, const ColorRGB &colour) : SceneObject(colour, SPHERE_KD,
 		SPHERE_KS, SPHERE_ALPHA, SPHERE_REFLECTIVITY), radius(radius), position(position)  {}
 
-	Sphere(const Vector3 &position, double radius, const ColorRGB &colour, double kD, double kS, double alphaS, double reflectivity, double transmittance) :
+	Sphere(const Vector3 &position, Real radius, const ColorRGB &colour, Real kD, Real kS, Real alphaS, Real reflectivity, Real transmittance) :
 	SceneObject(colour, kD, kS, alphaS, reflectivity, transmittance), radius(radius), position(position)  {}
 
-	/*
-	 * Calculate intersection of the sphere with the ray. If the ray starts inside the sphere,
-	 * intersection with the surface is also found.
-	 */
-	RaycastHit* intersectionWith(const Ray ray) override {
-
-        // Get ray parameters
-        const Vector3 O = ray.getOrigin();
-        const Vector3 D = ray.getDirection();
-
-        // Calculate quadratic coefficients
-        const double a = D.dot(D);
-        const double b = 2 * D.dot(O.subtract(position));
-        const double c = O.subtract(position).dot(O.subtract(position)) - pow(radius, 2);
-        double disc = pow(b, 2) - 4 * a * c;
-        double sol1 = 0;
-        double sol2 = 0;
-        double sol = 0;
-        if (disc > 0) {
-            sol1 = (-1 * b + sqrt(disc)) / (2 * a);
-            sol2 = (-1 * b - sqrt(disc)) / (2 * a);
-        } else if (disc == 0) { sol = -1 * b/ (2 * a); }
-        if (disc < 0 || (sol1 < 0 && sol2 < 0) || (disc == 0 && sol < 0)) { return new RaycastHit(); }
-        if (disc == 0 && sol > 0) {
-	        return new RaycastHit(*this, sol, ray.evaluateAt(sol) ,getNormalAt(ray.evaluateAt(sol)));
-        }
-        if ((sol1 > 0 && sol2 < 0) || (sol1 > 0 && sol2 > 0 && sol1 < sol2)) {
-	        return new RaycastHit(*this, sol1, ray.evaluateAt(sol1) ,getNormalAt(ray.evaluateAt(sol1)));
-        }
-        if ((sol2 > 0 && sol1 < 0) || (sol1 > 0 && sol2 > 0 && sol1 > sol2)) {
-	        return new RaycastHit(*this, sol2, ray.evaluateAt(sol2), getNormalAt(ray.evaluateAt(sol2)));
-        }
-        return new RaycastHit();
-    }
+	Sphere(const Vector3 &position, Real radius, const ColorRGB &colour, Real kD, Real kS, Real alphaS, Real reflectivity,
+		const ColorRGB &transmittance) :
+	SceneObject(colour, kD, kS, alphaS, reflectivity, transmittance), radius(radius), position(position)  {}
+
+	// The geometry of this sphere, using the given material index
+	[[nodiscard]] SpherePrimitive toPrimitive(const std::uint32_t material) const {
+		SpherePrimitive primitive = {position, radius, material};
+		primitive.precompute();
+		return primitive;
+	}
+
+	[[nodiscard]] Real intersectDistance(const Ray& ray) const override {return toPrimitive(0).intersectDistance(ray);}
 
 	// Get normal to surface at position
-	Vector3 getNormalAt(Vector3 position) override {return position.subtract(this->position).normalised();}
+	[[nodiscard]] Vector3 getNormalAt(const Vector3& position) const override {return toPrimitive(0).getNormalAt(position);}
+
+	[[nodiscard]] AABB getBounds() const override {return toPrimitive(0).getBounds();}
 };
 #endif //RAYTRACING_SPHERE_H
\ No newline at end of file
@@ -0,0 +1 @@
+#include "SphereSoA.h"
\ No newline at end of file
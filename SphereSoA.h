@@ -0,0 +1,149 @@
+#ifndef RAYTRACING_SPHERESOA_H
+#define RAYTRACING_SPHERESOA_H
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "Ray.h"
+#include "RealLanes.h"
+#include "Sphere.h"
+
+/*
+ * Sphere centres and squared radii in structure-of-arrays layout, so that one ray can be tested against several
+ * spheres per instruction, 4 at a time in double precision or 8 in single precision. The kernel is picked at runtime
+ * from what the CPU supports, falling back to scalar code.
+ */
+class SphereSoA {
+public:
+	// Number of spheres the widest kernel tests at once, the arrays are padded by this much
+	static constexpr std::uint32_t MAX_LANES = 32 / sizeof(Real);
+
+	// Ray values shared by every sphere test
+	struct RayConstants {
+		Real ox, oy, oz;
+		Real dx, dy, dz;
+		// Quadratic coefficient a = D.D
+		Real a;
+	};
+
+	using Kernel = int (*)(const SphereSoA&, std::uint32_t first, std::uint32_t count, const RayConstants&, Real& tMax);
+
+private:
+	std::vector<Real> cx, cy, cz, r2;
+
+	// Smallest positive root of the sphere quadratic, matching SpherePrimitive::intersectDistance
+	static Real scalarDistance(const SphereSoA& s, const std::uint32_t i, const RayConstants& ray) {
+		const Real ocx = ray.ox - s.cx[i], ocy = ray.oy - s.cy[i], ocz = ray.oz - s.cz[i];
+		const Real b = 2 * (ray.dx * ocx + ray.dy * ocy + ray.dz * ocz);
+		const Real c = ocx * ocx + ocy * ocy + ocz * ocz - s.r2[i];
+		const Real disc = b * b - 4 * ray.a * c;
+		if (disc < 0) return NO_INTERSECTION;
+		const Real root = std::sqrt(disc);
+		const Real sol1 = (-1 * b + root) / (2 * ray.a);
+		const Real sol2 = (-1 * b - root) / (2 * ray.a);
+		return sol2 > 0 ? sol2 : sol1 > 0 ? sol1 : NO_INTERSECTION;
+	}
+
+	static int scalarKernel(const SphereSoA& s, const std::uint32_t first, const std::uint32_t count,
+		const RayConstants& ray, Real& tMax) {
+		int closest = -1;
+		for (std::uint32_t i = first; i < first + count; ++i) {
+			if (const Real t = scalarDistance(s, i, ray); t < tMax) {
+				tMax = t;
+				closest = static_cast<int>(i);
+			}
+		}
+		return closest;
+	}
+
+#ifdef RAYTRACING_X86_LANES
+	// Tests RealLanes::WIDTH spheres per iteration, 4 in double precision or 8 in single precision
+	__attribute__((target("avx2")))
+	static int avx2Kernel(const SphereSoA& s, const std::uint32_t first, const std::uint32_t count,
+		const RayConstants& ray, Real& tMax) {
+		using namespace RealLanes;
+		const Lanes ox = set1(ray.ox), oy = set1(ray.oy), oz = set1(ray.oz);
+		const Lanes dx = set1(ray.dx), dy = set1(ray.dy), dz = set1(ray.dz);
+		const Lanes fourA = set1(4 * ray.a), twoA = set1(2 * ray.a);
+		const Lanes zero = set1(0), two = set1(2);
+		const Lanes miss = set1(NO_INTERSECTION);
+		Real offsets[WIDTH];
+		for (int lane = 0; lane < WIDTH; ++lane) {offsets[lane] = static_cast<Real>(lane);}
+		const Lanes laneIndex = load(offsets);
+		int closest = -1;
+		for (std::uint32_t i = first; i < first + count; i += WIDTH) {
+			const Lanes ocx = sub(ox, load(&s.cx[i]));
+			const Lanes ocy = sub(oy, load(&s.cy[i]));
+			const Lanes ocz = sub(oz, load(&s.cz[i]));
+			const Lanes b = mul(two, dot(dx, dy, dz, ocx, ocy, ocz));
+			const Lanes c = sub(dot(ocx, ocy, ocz, ocx, ocy, ocz), load(&s.r2[i]));
+			const Lanes disc = sub(mul(b, b), mul(fourA, c));
+			const Lanes root = RealLanes::sqrt(max(disc, zero));
+			const Lanes sol1 = div(add(sub(zero, b), root), twoA);
+			const Lanes sol2 = div(sub(sub(zero, b), root), twoA);
+			Lanes t = select(greater(sol2, zero), sol2, select(greater(sol1, zero), sol1, miss));
+			// Discard misses and lanes past the end of the range
+			const Lanes valid = both(greaterEqual(disc, zero),
+				less(laneIndex, set1(static_cast<Real>(first + count - i))));
+			t = select(valid, t, miss);
+			int hits = bits(less(t, set1(tMax)));
+			if (hits == 0) continue;
+			Real lanes[WIDTH];
+			store(lanes, t);
+			for (; hits != 0; hits &= hits - 1) {
+				const int lane = __builtin_ctz(hits);
+				if (lanes[lane] < tMax) {
+					tMax = lanes[lane];
+					closest = static_cast<int>(i) + lane;
+				}
+			}
+		}
+		return closest;
+	}
+#endif
+
+	// Pick the widest kernel the CPU supports
+	static Kernel selectKernel() {
+#ifdef RAYTRACING_X86_LANES
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) return avx2Kernel;
+#endif
+		return scalarKernel;
+	}
+
+	inline static const Kernel kernel = selectKernel();
+
+public:
+	// Copy the spheres into the arrays, in the order given
+	void assign(const std::vector<SpherePrimitive>& spheres) {
+		// The padding only keeps vector loads in bounds, the kernels mask off lanes past the end of a range
+		const size_t padded = spheres.size() + MAX_LANES;
+		cx.assign(padded, 0);
+		cy.assign(padded, 0);
+		cz.assign(padded, 0);
+		r2.assign(padded, 0);
+		for (size_t i = 0; i < spheres.size(); ++i) {
+			cx[i] = spheres[i].position.x;
+			cy[i] = spheres[i].position.y;
+			cz[i] = spheres[i].position.z;
+			r2[i] = spheres[i].radiusSquared;
+		}
+	}
+
+	static RayConstants constantsFor(const Ray& ray) {
+		const Vector3 O = ray.getOrigin();
+		const Vector3 D = ray.getDirection();
+		return {O.x, O.y, O.z, D.x, D.y, D.z, D.dot(D)};
+	}
+
+	/*
+	 * Intersect the ray with spheres [first, first + count), returning the index of the closest one hit before tMax
+	 * and shortening tMax to its distance, or -1 if none of them is hit.
+	 */
+	int intersect(const RayConstants& ray, const std::uint32_t first, const std::uint32_t count, Real& tMax) const {
+		return kernel(*this, first, count, ray, tMax);
+	}
+};
+
+#endif //RAYTRACING_SPHERESOA_H
@@ -0,0 +1 @@
+#include "TileQueue.h"
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef RAYTRACING_TILEQUEUE_H
+#define RAYTRACING_TILEQUEUE_H
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+/*
+ * Work-stealing queue of image tiles. Each worker owns a contiguous range of tile indices and takes
+ * tiles from the front of it; once its own range is empty it steals from the back of another worker's range.
+ */
+class TileQueue {
+
+	// Range of tiles [begin, end) packed into one word so owner and thieves can race on it with a single CAS
+	struct alignas(64) Range {
+		std::atomic<std::uint64_t> bounds;
+	};
+
+	std::unique_ptr<Range[]> ranges;
+	unsigned workers;
+
+	static std::uint64_t pack(const std::uint32_t begin, const std::uint32_t end) {
+		return static_cast<std::uint64_t>(begin) << 32 | end;
+	}
+
+public:
+	TileQueue(const int tiles, const unsigned workers) : ranges(new Range[workers]), workers(workers) {
+		// Split the tiles evenly, giving the remainder to the first workers
+		const int perWorker = tiles / static_cast<int>(workers);
+		const int remainder = tiles % static_cast<int>(workers);
+		int begin = 0;
+		for (unsigned i = 0; i < workers; ++i) {
+			const int end = begin + perWorker + (static_cast<int>(i) < remainder ? 1 : 0);
+			ranges[i].bounds.store(pack(begin, end), std::memory_order_relaxed);
+			begin = end;
+		}
+	}
+
+	// Take the next tile for a worker, or -1 if every range is empty. Sets stolen if the tile came from another worker.
+	int pop(const unsigned worker, bool& stolen) {
+		for (unsigned i = 0; i < workers; ++i) {
+			Range& range = ranges[(worker + i) % workers];
+			std::uint64_t bounds = range.bounds.load(std::memory_order_relaxed);
+			while (true) {
+				const auto begin = static_cast<std::uint32_t>(bounds >> 32);
+				const auto end = static_cast<std::uint32_t>(bounds);
+				if (begin >= end) break;
+				// The owner takes from the front, thieves take from the back
+				const std::uint64_t next = i == 0 ? pack(begin + 1, end) : pack(begin, end - 1);
+				if (range.bounds.compare_exchange_weak(bounds, next, std::memory_order_relaxed)) {
+					stolen = i != 0;
+					return static_cast<int>(i == 0 ? begin : end - 1);
+				}
+			}
+		}
+		return -1;
+	}
+};
+
+#endif //RAYTRACING_TILEQUEUE_H
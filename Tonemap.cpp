@@ -0,0 +1 @@
+#include "Tonemap.h"
@@ -0,0 +1,205 @@
+#ifndef RAYTRACING_TONEMAP_H
+#define RAYTRACING_TONEMAP_H
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RAYTRACING_X86_TONEMAP 1
+#include <immintrin.h>
+#endif
+
+/*
+ * Sigmoidal tone mapping followed by gamma display encoding, with parameters set at runtime. Whole rows are encoded
+ * at a time using polynomial approximations of log2 and exp2, vectorised when the CPU allows, and the gamma stage can
+ * optionally use a lookup table instead.
+ */
+class Tonemap {
+public:
+	// Entries in the gamma lookup table
+	static constexpr int LUT_SIZE = 4096;
+
+private:
+	float a = 2;  // controls brightness
+	float b = 1.3f; // controls contrast
+	float gamma = 2.2f;
+	bool lookupGamma = false;
+
+	// (0.5 / a)^b, the midpoint term of the sigmoid
+	float midpoint = 0;
+	float invGamma = 0;
+
+	/*
+	 * The lookup table is indexed by the top bits of the float, a few bits of mantissa for each octave below 1, so its
+	 * steps are relative and stay fine enough near black where the gamma curve is steepest. It reaches down to where
+	 * the exact encoding is code 0, which takes more octaves the higher the gamma, and the octaves share the entries
+	 * between them. Each entry holds the code for the middle of its range. When the gamma curve changes by a code or
+	 * more across an entry, which only happens for gammas far below 1, the exact path is used instead.
+	 */
+	std::uint32_t lutBase = 0;
+	int lutShift = 0;
+	bool lutAccurate = false;
+	std::array<std::uint8_t, LUT_SIZE> gammaTable{};
+
+	static constexpr float SQRT2 = 1.41421356f;
+	static constexpr float LN2 = 0.69314718f;
+
+	using PowKernel = void (*)(const float* in, float exponent, float* out, int count);
+
+public:
+	Tonemap() {update();}
+
+	Tonemap(const float a, const float b, const float gamma) : a(a), b(b), gamma(gamma) {update();}
+
+	void setParameters(const float a, const float b, const float gamma) {
+		this->a = a;
+		this->b = b;
+		this->gamma = gamma;
+		update();
+	}
+
+	void setLookupGamma(const bool lookupGamma) {this->lookupGamma = lookupGamma;}
+
+	[[nodiscard]] float getA() const {return a;}
+
+	[[nodiscard]] float getB() const {return b;}
+
+	[[nodiscard]] float getGamma() const {return gamma;}
+
+	// Whether encode uses the lookup table, which it only does if asked to and the table is accurate for the gamma
+	[[nodiscard]] bool usesLookupGamma() const {return lookupGamma && lutAccurate;}
+
+	// Reference tone mapping of one channel using the standard library, which encode() approximates
+	[[nodiscard]] float apply(const float linear) const {
+		const float powered = std::pow(linear, b);
+		return std::pow(powered / (powered + midpoint), invGamma);
+	}
+
+	/*
+	 * Tone map and display encode count linear values, each multiplied by scale first, to 8 bit codes. The scratch
+	 * array needs room for count floats.
+	 */
+	void encode(const float* linear, const float scale, float* scratch, std::uint8_t* codes, const int count) const {
+		for (int i = 0; i < count; ++i) {scratch[i] = linear[i] * scale;}
+		powKernel(scratch, b, scratch, count);
+		for (int i = 0; i < count; ++i) {scratch[i] = scratch[i] / (scratch[i] + midpoint);}
+		if (usesLookupGamma()) {
+			for (int i = 0; i < count; ++i) {codes[i] = gammaTable[lutIndex(scratch[i])];}
+			return;
+		}
+		powKernel(scratch, invGamma, scratch, count);
+		// Truncating conversion, as ColorRGB does
+		for (int i = 0; i < count; ++i) {codes[i] = static_cast<std::uint8_t>(255 * std::max(0.f, std::min(1.f, scratch[i])));}
+	}
+
+	// Polynomial approximation of log2 for positive normal floats, accurate to about 1e-7
+	static float fastLog2(const float x) {
+		const auto bits = std::bit_cast<std::uint32_t>(std::max(x, 1.17549435e-38f));
+		float exponent = static_cast<float>(static_cast<int>(bits >> 23) - 127);
+		float mantissa = std::bit_cast<float>((bits & 0x7fffff) | 0x3f800000);
+		// Centre the mantissa on 1 to keep the series short
+		if (mantissa > SQRT2) {
+			mantissa *= 0.5f;
+			exponent += 1;
+		}
+		const float s = (mantissa - 1) / (mantissa + 1), s2 = s * s;
+		return exponent + s * (2.88539008f + s2 * (0.96179669f + s2 * (0.57707801f + s2 * 0.41219858f)));
+	}
+
+	// Polynomial approximation of exp2, accurate to a few parts in a million
+	static float fastExp2(float x) {
+		x = std::max(-126.f, std::min(126.f, x));
+		const float whole = std::nearbyint(x);
+		const float f = x - whole;
+		const float p = 1 + f * (LN2 + f * (0.24022651f + f * (0.05550411f + f * (0.00961813f + f * 0.00133336f))));
+		return p * std::bit_cast<float>(static_cast<std::uint32_t>(static_cast<int>(whole) + 127) << 23);
+	}
+
+private:
+	void update() {
+		midpoint = std::pow(0.5f / a, b);
+		invGamma = 1 / gamma;
+
+		// Below 255^-gamma every value encodes to code 0, so that is where the table can start
+		const int octaves = std::clamp(static_cast<int>(std::ceil(gamma * std::log2(255.f))), 1, 126);
+		const int mantissaBits = std::min(23, static_cast<int>(std::bit_width(static_cast<unsigned>(LUT_SIZE / octaves))) - 1);
+		// The code changes by at most 255 / gamma per unit of log2, and an entry spans 2^-mantissaBits of that
+		lutAccurate = 255 * invGamma <= static_cast<float>(1 << mantissaBits);
+		if (!lutAccurate) return;
+		lutShift = 23 - mantissaBits;
+		lutBase = static_cast<std::uint32_t>(127 - octaves) << 23;
+		for (int i = 0; i < LUT_SIZE; ++i) {
+			const float low = std::bit_cast<float>(lutBase + (static_cast<std::uint32_t>(i) << lutShift));
+			const float high = std::bit_cast<float>(lutBase + (static_cast<std::uint32_t>(i + 1) << lutShift));
+			const float encoded = std::pow((low + high) / 2, invGamma);
+			gammaTable[i] = static_cast<std::uint8_t>(255 * std::max(0.f, std::min(1.f, encoded)));
+		}
+	}
+
+	[[nodiscard]] int lutIndex(const float display) const {
+		const auto bits = static_cast<std::int64_t>(std::bit_cast<std::uint32_t>(std::max(display, 0.f)));
+		return static_cast<int>(std::clamp<std::int64_t>((bits - lutBase) >> lutShift, 0, LUT_SIZE - 1));
+	}
+
+	static void scalarPow(const float* in, const float exponent, float* out, const int count) {
+		for (int i = 0; i < count; ++i) {out[i] = in[i] > 0 ? fastExp2(exponent * fastLog2(in[i])) : 0;}
+	}
+
+#ifdef RAYTRACING_X86_TONEMAP
+	// The same approximations as fastLog2 and fastExp2, 8 values at a time
+	__attribute__((target("avx2,fma")))
+	static void avx2Pow(const float* in, const float exponent, float* out, const int count) {
+		const __m256 one = _mm256_set1_ps(1), half = _mm256_set1_ps(0.5f), zero = _mm256_setzero_ps();
+		const __m256 e = _mm256_set1_ps(exponent);
+		int i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const __m256 x = _mm256_loadu_ps(in + i);
+			// log2
+			const __m256i bits = _mm256_castps_si256(_mm256_max_ps(x, _mm256_set1_ps(1.17549435e-38f)));
+			__m256 exponentPart = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+			__m256 mantissa = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x7fffff)),
+				_mm256_set1_epi32(0x3f800000)));
+			const __m256 large = _mm256_cmp_ps(mantissa, _mm256_set1_ps(SQRT2), _CMP_GT_OQ);
+			mantissa = _mm256_blendv_ps(mantissa, _mm256_mul_ps(mantissa, half), large);
+			exponentPart = _mm256_add_ps(exponentPart, _mm256_and_ps(large, one));
+			const __m256 s = _mm256_div_ps(_mm256_sub_ps(mantissa, one), _mm256_add_ps(mantissa, one));
+			const __m256 s2 = _mm256_mul_ps(s, s);
+			__m256 series = _mm256_fmadd_ps(s2, _mm256_set1_ps(0.41219858f), _mm256_set1_ps(0.57707801f));
+			series = _mm256_fmadd_ps(s2, series, _mm256_set1_ps(0.96179669f));
+			series = _mm256_fmadd_ps(s2, series, _mm256_set1_ps(2.88539008f));
+			const __m256 log2x = _mm256_fmadd_ps(s, series, exponentPart);
+
+			// exp2
+			__m256 y = _mm256_mul_ps(e, log2x);
+			y = _mm256_max_ps(_mm256_set1_ps(-126), _mm256_min_ps(_mm256_set1_ps(126), y));
+			const __m256 whole = _mm256_round_ps(y, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+			const __m256 f = _mm256_sub_ps(y, whole);
+			__m256 p = _mm256_fmadd_ps(f, _mm256_set1_ps(0.00133336f), _mm256_set1_ps(0.00961813f));
+			p = _mm256_fmadd_ps(f, p, _mm256_set1_ps(0.05550411f));
+			p = _mm256_fmadd_ps(f, p, _mm256_set1_ps(0.24022651f));
+			p = _mm256_fmadd_ps(f, p, _mm256_set1_ps(LN2));
+			p = _mm256_fmadd_ps(f, p, one);
+			const __m256 scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(whole),
+				_mm256_set1_epi32(127)), 23));
+			const __m256 result = _mm256_mul_ps(p, scale);
+			_mm256_storeu_ps(out + i, _mm256_and_ps(result, _mm256_cmp_ps(x, zero, _CMP_GT_OQ)));
+		}
+		scalarPow(in + i, exponent, out + i, count - i);
+	}
+#endif
+
+	// Pick the widest kernel the CPU supports
+	static PowKernel selectPowKernel() {
+#ifdef RAYTRACING_X86_TONEMAP
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return avx2Pow;
+#endif
+		return scalarPow;
+	}
+
+	inline static const PowKernel powKernel = selectPowKernel();
+};
+
+#endif //RAYTRACING_TONEMAP_H
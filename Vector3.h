@@ -2,73 +2,86 @@
 #define RAYTRACING_VECTOR3_H
 #include <cmath>
 
-class Vector3 {
+#include "Real.h"
+
+// Three component vector over a scalar type T, use the Vector3 alias for the build's precision
+template <typename T>
+class Vector3T {
 public:
-	 double x, y, z;
-	 explicit Vector3(const double uniform):Vector3(uniform, uniform, uniform) {};
+	 T x, y, z;
+	 explicit Vector3T(const T uniform):Vector3T(uniform, uniform, uniform) {};
+
+	 Vector3T(const T x, const T y, const T z) : x(x), y(y), z(z) {}
+
+	// Convert from a vector of another precision
+	template <typename U>
+	explicit Vector3T(const Vector3T<U>& other) : x(static_cast<T>(other.x)), y(static_cast<T>(other.y)),
+		z(static_cast<T>(other.z)) {}
 
-	 Vector3(const double x, const double y, const double z) : x(x), y(y), z(z) {}
+	// Get a component by axis index, 0 = x, 1 = y, 2 = z
+	[[nodiscard]] T get(const int axis) const {return axis == 0 ? x : axis == 1 ? y : z;}
 
 	// Add two vectors together
-	 [[nodiscard]] Vector3 add(Vector3 other) const {return {x + other.x, y + other.y, z + other.z};}
+	 [[nodiscard]] Vector3T add(Vector3T other) const {return {x + other.x, y + other.y, z + other.z};}
 
 	// Add a scalar to a vector
-	[[nodiscard]] Vector3 add(double other) const {return {x + other, y + other, z + other};}
+	[[nodiscard]] Vector3T add(T other) const {return {x + other, y + other, z + other};}
 
 	// Subtract two vectors
-	[[nodiscard]] Vector3 subtract(Vector3 other) const {return {x - other.x, y - other.y, z - other.z};}
+	[[nodiscard]] Vector3T subtract(Vector3T other) const {return {x - other.x, y - other.y, z - other.z};}
 
-	[[nodiscard]] Vector3 subtract(double other) const {return {x - other, y - other, z - other};}
+	[[nodiscard]] Vector3T subtract(T other) const {return {x - other, y - other, z - other};}
 
 	// Scale a vector by a scalar
-	[[nodiscard]] Vector3 scale(double scalar) const {return {scalar * x, scalar * y, scalar * z};}
+	[[nodiscard]] Vector3T scale(T scalar) const {return {scalar * x, scalar * y, scalar * z};}
 
 	// Hadamard product, scales the vector in an element-wise fashion
-	[[nodiscard]] Vector3 scale(Vector3 other) const {return {x * other.x, y * other.y, z * other.z};}
+	[[nodiscard]] Vector3T scale(Vector3T other) const {return {x * other.x, y * other.y, z * other.z};}
 
 	// Dot product of two vectors
-	[[nodiscard]] double dot(Vector3 other) const {return x * other.x + y * other.y + z * other.z;}
+	[[nodiscard]] T dot(Vector3T other) const {return x * other.x + y * other.y + z * other.z;}
 
 	// Cross product of two vectors
-	[[nodiscard]] Vector3 cross(Vector3 other) const {
+	[[nodiscard]] Vector3T cross(Vector3T other) const {
 		return {y * other.z - z * other.y, z * other.x - x * other.z, x * other.y - y * other.x};
 	}
 
 	// Element-wise power function
-	[[nodiscard]] Vector3 power(double e) const {return {pow(x,e), pow(y,e), pow(z,e)};}
+	[[nodiscard]] Vector3T power(T e) const {return {std::pow(x,e), std::pow(y,e), std::pow(z,e)};}
 
 	// Element-wise inverse (1/v)
-	[[nodiscard]] Vector3 inv() const {return {1/x, 1/y, 1/z};}
+	[[nodiscard]] Vector3T inv() const {return {1/x, 1/y, 1/z};}
 
 
 	// Magnitude of a vector
-	[[nodiscard]] double magnitude() const {return sqrt(x * x + y * y + z * z);}
+	[[nodiscard]] T magnitude() const {return std::sqrt(x * x + y * y + z * z);}
 
 	// Normalise a vector
-	[[nodiscard]] Vector3 normalised() const {
-		const double magnitude = this->magnitude();
+	[[nodiscard]] Vector3T normalised() const {
+		const T magnitude = this->magnitude();
 		return {x / magnitude, y / magnitude, z / magnitude};
 	}
 
 	// Calculate mirror-like reflection
-	[[nodiscard]] Vector3 reflectIn(Vector3 N) const {return N.scale(2 * this->dot(N)).subtract(*this);}
+	[[nodiscard]] Vector3T reflectIn(Vector3T N) const {return N.scale(2 * this->dot(N)).subtract(*this);}
 
 	// Creates a random vector inside the unit sphere
-	static Vector3 randomInsideUnitSphere() {
-		const double r = rand();
-		const double theta = rand() * M_PI;
-		const double phi = rand() * M_PI * 2;
-		double x = r * sin(theta) * cos(phi);
-		double y = r * sin(theta) * sin(phi);
-		double z = r * cos(theta);
+	static Vector3T randomInsideUnitSphere() {
+		const T r = rand();
+		const T theta = rand() * static_cast<T>(M_PI);
+		const T phi = rand() * static_cast<T>(M_PI) * 2;
+		T x = r * std::sin(theta) * std::cos(phi);
+		T y = r * std::sin(theta) * std::sin(phi);
+		T z = r * std::cos(theta);
 		return {x, y, z};
 	}
 
 	// Determine if two vectors are equal
-	[[nodiscard]] bool equals(Vector3 other) const {return x == other.x && y == other.y && z == other.z;}
+	[[nodiscard]] bool equals(Vector3T other) const {return x == other.x && y == other.y && z == other.z;}
 
 	[[nodiscard]] bool isZero() const {return (x==0 && y==0 && z==0);}
 };
 
+using Vector3 = Vector3T<Real>;
 
 #endif //RAYTRACING_VECTOR3_H
\ No newline at end of file
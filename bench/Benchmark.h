@@ -0,0 +1,47 @@
+#ifndef RAYTRACING_BENCHMARK_H
+#define RAYTRACING_BENCHMARK_H
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+/*
+ * Minimal timing harness for rt_bench. A benchmark body performs a fixed batch of operations per call, and is called
+ * until enough time has passed to trust the clock. Several rounds are timed and the fastest is kept, being the one
+ * least disturbed by whatever else the machine was doing.
+ */
+namespace Benchmark {
+	// Stop the compiler from optimising away a value that is never otherwise used
+	template <typename T>
+	inline void keep(const T& value) {
+		asm volatile("" : : "r"(&value) : "memory");
+	}
+
+	struct Result {
+		std::string name;
+		double nsPerOperation = 0;
+		std::uint64_t operations = 0;
+	};
+
+	template <typename Body>
+	Result run(const std::string& name, const int batch, Body&& body, const double minSeconds, const int rounds = 3) {
+		using Clock = std::chrono::steady_clock;
+		Result result{name, std::numeric_limits<double>::infinity(), 0};
+		for (int round = 0; round < rounds; ++round) {
+			std::uint64_t calls = 0;
+			const Clock::time_point start = Clock::now();
+			double seconds;
+			do {
+				body();
+				calls++;
+				seconds = std::chrono::duration<double>(Clock::now() - start).count();
+			} while (seconds < minSeconds / rounds);
+			result.nsPerOperation = std::min(result.nsPerOperation, seconds * 1e9 / (calls * batch));
+			result.operations += calls * batch;
+		}
+		return result;
+	}
+}
+
+#endif //RAYTRACING_BENCHMARK_H
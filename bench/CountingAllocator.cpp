@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "CountingAllocator.h"
+
+/*
+ * Every form of the global operator new and operator delete is replaced, so that whichever form a pointer comes from
+ * it goes back through the matching release.
+ */
+namespace {
+	constexpr std::size_t DEFAULT_ALIGNMENT = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+	void* allocate(const std::size_t size, const std::size_t alignment) noexcept {
+		if (CountingAllocator::counting.load(std::memory_order_relaxed)) {
+			CountingAllocator::allocations.fetch_add(1, std::memory_order_relaxed);
+		}
+		if (alignment <= DEFAULT_ALIGNMENT) return std::malloc(size ? size : 1);
+		return std::aligned_alloc(alignment, (std::max<std::size_t>(size, 1) + alignment - 1) / alignment * alignment);
+	}
+
+	// Memory from malloc and aligned_alloc alike is given back with free
+	void release(void* memory) noexcept {std::free(memory);}
+
+	void* allocateOrThrow(const std::size_t size, const std::size_t alignment) {
+		if (void* memory = allocate(size, alignment)) return memory;
+		throw std::bad_alloc();
+	}
+}
+
+void* operator new(const std::size_t size) {return allocateOrThrow(size, DEFAULT_ALIGNMENT);}
+
+void* operator new[](const std::size_t size) {return allocateOrThrow(size, DEFAULT_ALIGNMENT);}
+
+void* operator new(const std::size_t size, const std::align_val_t alignment) {
+	return allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](const std::size_t size, const std::align_val_t alignment) {
+	return allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new(const std::size_t size, const std::nothrow_t&) noexcept {return allocate(size, DEFAULT_ALIGNMENT);}
+
+void* operator new[](const std::size_t size, const std::nothrow_t&) noexcept {return allocate(size, DEFAULT_ALIGNMENT);}
+
+void* operator new(const std::size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](const std::size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* memory) noexcept {release(memory);}
+
+void operator delete[](void* memory) noexcept {release(memory);}
+
+void operator delete(void* memory, std::size_t) noexcept {release(memory);}
+
+void operator delete[](void* memory, std::size_t) noexcept {release(memory);}
+
+void operator delete(void* memory, std::align_val_t) noexcept {release(memory);}
+
+void operator delete[](void* memory, std::align_val_t) noexcept {release(memory);}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept {release(memory);}
+
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept {release(memory);}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {release(memory);}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {release(memory);}
+
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept {release(memory);}
+
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept {release(memory);}
@@ -0,0 +1,25 @@
+#ifndef RAYTRACING_COUNTINGALLOCATOR_H
+#define RAYTRACING_COUNTINGALLOCATOR_H
+#include <atomic>
+#include <cstdint>
+
+/*
+ * Counts heap allocations for rt_bench and allocation_test. CountingAllocator.cpp replaces every form of the global
+ * operator new and operator delete, and a target that links it counts every allocation made while counting is set.
+ */
+namespace CountingAllocator {
+	inline std::atomic<std::uint64_t> allocations = 0;
+	inline std::atomic<bool> counting = false;
+
+	// Run body with allocations counted, returning how many it made
+	template <typename Body>
+	std::uint64_t count(Body&& body) {
+		allocations = 0;
+		counting = true;
+		body();
+		counting = false;
+		return allocations;
+	}
+}
+
+#endif //RAYTRACING_COUNTINGALLOCATOR_H
@@ -0,0 +1,545 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Benchmark.h"
+#include "Camera.h"
+#include "ColorRGB.h"
+#include "CountingAllocator.h"
+#include "Framebuffer.h"
+#include "Plane.h"
+#include "Renderer.h"
+#include "Resolve.h"
+#include "Scene.h"
+#include "SceneFile.h"
+#include "SceneGenerator.h"
+#include "SceneLoader.h"
+#include "Sphere.h"
+#include "Tonemap.h"
+#include "Vector3.h"
+
+// Microbenchmarks of the hot primitives, and end-to-end renders of scenes of growing size, written out as JSON
+namespace {
+	constexpr const char* PRECISION = sizeof(Real) == sizeof(float) ? "float" : "double";
+	constexpr const char* OTHER_PRECISION = sizeof(Real) == sizeof(float) ? "double" : "float";
+	// Scene rendered by both precisions to compare them, with many reflective spheres to show up self intersection
+	constexpr const char* PRECISION_SCENE = "reflective_grid";
+	constexpr int PRECISION_SIZE = 500;
+
+	struct Options {
+		std::string jsonPath = "rt_bench.json";
+		std::vector<std::string> scenes = {"ball_field"};
+		std::vector<int> sizes = {10, 1000, 100000, 1000000};
+		int width = 320, height = 240, frames = 3, bounces = 2, lightSamples = 0, seed = 1;
+		int loadElements = 1000000;
+		bool packets = true;
+		std::string precisionImage = std::string("rt_bench_") + PRECISION + ".ppm";
+		std::string precisionReference = std::string("rt_bench_") + OTHER_PRECISION + ".ppm";
+		unsigned threads = 0;
+		double minSeconds = 0.3;
+	};
+
+	struct SceneResult {
+		std::string name;
+		int size = 0;
+		double buildSeconds = 0, frameSeconds = 0;
+		double primaryMraysPerSecond = 0, nsPerPixel = 0, allocationsPerFrame = 0;
+		// Every ray traced, only known when the counters are compiled in
+		std::uint64_t rays = 0;
+	};
+
+	struct LoadResult {
+		std::string format;
+		unsigned threads = 1;
+		int elements = 0;
+		std::uint64_t bytes = 0;
+		// From the text or file to a committed scene, BVH included
+		double seconds = 0;
+	};
+
+	// An image of the precision scene with the time per frame it took, as written by this build or the other one
+	struct PrecisionImage {
+		std::string precision;
+		int width = 0, height = 0, seed = 0, bounces = 0;
+		double frameSeconds = 0;
+		std::vector<std::uint8_t> pixels;
+	};
+
+	struct PrecisionResult {
+		PrecisionImage image;
+		// Set when the other precision build has written its image of the same scene at the same size
+		bool compared = false;
+		// Why the images were not compared otherwise
+		std::string note;
+		double otherFrameSeconds = 0, meanDifference = 0;
+		int maxDifference = 0;
+		// Channels differing by more than 8 codes, beyond tone mapping noise
+		std::uint64_t channelsOver8 = 0;
+	};
+
+	void printUsage(const char* program) {
+		std::cerr << "Usage: " << program << " [options]\n"
+			<< "  --json <file>     where to write the results (default rt_bench.json)\n"
+			<< "  --scenes <a,...>  generated scenes to render (default ball_field), any of sphereflake, ball_field,\n"
+			<< "                    reflective_grid and many_light_room\n"
+			<< "  --sizes <n,...>   sizes each scene is generated at (default 10,1000,100000,1000000)\n"
+			<< "  --seed <n>        seed of the generated scenes (default 1)\n"
+			<< "  --light-samples <n>  lights sampled per shading point, 0 for every light (default 0)\n"
+			<< "  --width <n>       image width of the scene benchmarks (default 320)\n"
+			<< "  --height <n>      image height of the scene benchmarks (default 240)\n"
+			<< "  --frames <n>      frames rendered per scene (default 3)\n"
+			<< "  --no-packets      trace primary rays one at a time, as the renderer's --no-packets does\n"
+			<< "  --threads <n>     render and BVH build threads (default: one per hardware thread)\n"
+			<< "  --load-elements <n>  spheres in the scene file loading benchmark (default 1000000)\n"
+			<< "  --precision-image <file>  where to write this build's image of the precision scene\n"
+			<< "                    (default rt_bench_" << PRECISION << ".ppm)\n"
+			<< "  --precision-reference <file>  image written by the " << OTHER_PRECISION << " build to compare against, if it\n"
+			<< "                    exists (default rt_bench_" << OTHER_PRECISION << ".ppm)\n"
+			<< "  --quick           shorter microbenchmarks, for smoke testing\n";
+	}
+
+	int parseCount(const std::string& option, const std::string& value) {
+		char* end = nullptr;
+		const long number = std::strtol(value.c_str(), &end, 10);
+		if (value.empty() || *end != '\0' || number < 1) {
+			throw std::invalid_argument(option + " expects a positive integer, got '" + value + "'");
+		}
+		return static_cast<int>(number);
+	}
+
+	std::vector<std::string> splitList(const std::string& list) {
+		std::vector<std::string> items;
+		for (size_t start = 0; start <= list.size();) {
+			const size_t comma = std::min(list.find(',', start), list.size());
+			items.push_back(list.substr(start, comma - start));
+			start = comma + 1;
+		}
+		return items;
+	}
+
+	Options parseOptions(const int argc, char* argv[]) {
+		Options options;
+		for (int i = 1; i < argc; ++i) {
+			const std::string arg = argv[i];
+			auto value = [&]() -> std::string {
+				if (i + 1 >= argc) throw std::invalid_argument(arg + " expects a value");
+				return argv[++i];
+			};
+			if (arg == "--help" || arg == "-h") {
+				printUsage(argv[0]);
+				std::exit(0);
+			}
+			if (arg == "--json") options.jsonPath = value();
+			else if (arg == "--width") options.width = parseCount(arg, value());
+			else if (arg == "--height") options.height = parseCount(arg, value());
+			else if (arg == "--frames") options.frames = parseCount(arg, value());
+			else if (arg == "--threads") options.threads = parseCount(arg, value());
+			else if (arg == "--quick") options.minSeconds = 0.03;
+			else if (arg == "--no-packets") options.packets = false;
+			else if (arg == "--seed") options.seed = parseCount(arg, value());
+			else if (arg == "--load-elements") options.loadElements = parseCount(arg, value());
+			else if (arg == "--precision-image") options.precisionImage = value();
+			else if (arg == "--precision-reference") options.precisionReference = value();
+			else if (arg == "--light-samples") options.lightSamples = parseCount(arg, value());
+			else if (arg == "--scenes") options.scenes = splitList(value());
+			else if (arg == "--sizes") {
+				options.sizes.clear();
+				for (const std::string& size : splitList(value())) {options.sizes.push_back(parseCount(arg, size));}
+			}
+			else throw std::invalid_argument("unknown option " + arg);
+		}
+		return options;
+	}
+
+	unsigned threadCount(const Options& options) {
+		return options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// Rays from near the origin in random directions, mostly towards +z where the test objects are
+	std::vector<Ray> randomRays(const int count, std::mt19937& random) {
+		std::uniform_real_distribution<Real> spread(-1, 1);
+		std::vector<Ray> rays;
+		rays.reserve(count);
+		for (int i = 0; i < count; ++i) {
+			rays.emplace_back(Vector3(spread(random), spread(random), spread(random)).scale(0.1),
+				Vector3(spread(random), spread(random), 2).normalised());
+		}
+		return rays;
+	}
+
+	std::vector<Benchmark::Result> runMicrobenchmarks(const Options& options) {
+		constexpr int BATCH = 1024;
+		std::mt19937 random(1);
+		std::uniform_real_distribution<Real> unit(0, 1);
+		const std::vector<Ray> rays = randomRays(BATCH, random);
+		std::vector<Vector3> vectors;
+		std::vector<ColorRGB> colours;
+		for (int i = 0; i < BATCH; ++i) {
+			vectors.emplace_back(unit(random), unit(random), unit(random));
+			colours.emplace_back(unit(random), unit(random), unit(random));
+		}
+
+		std::vector<Benchmark::Result> results;
+		results.push_back(Benchmark::run("vector3_dot_cross", BATCH, [&] {
+			Vector3 sum(0);
+			for (int i = 1; i < BATCH; ++i) {sum = sum.add(vectors[i].cross(vectors[i - 1]).scale(vectors[i].dot(sum)));}
+			Benchmark::keep(sum);
+		}, options.minSeconds));
+		results.push_back(Benchmark::run("vector3_normalised", BATCH, [&] {
+			for (const Vector3& vector : vectors) {Benchmark::keep(vector.normalised());}
+		}, options.minSeconds));
+		results.push_back(Benchmark::run("colour_scale_add", BATCH, [&] {
+			ColorRGB sum(0);
+			for (const ColorRGB& colour : colours) {sum = sum.add(colour.scale(colour));}
+			Benchmark::keep(sum);
+		}, options.minSeconds));
+
+		const Sphere sphere(Vector3(0, 0, 5), 1, ColorRGB(1));
+		const SpherePrimitive spherePrimitive = sphere.toPrimitive(0);
+		const Plane plane(Vector3(0, -1, 0), Vector3(0.1, 1, 0.2), ColorRGB(1));
+		const PlanePrimitive planePrimitive = plane.toPrimitive(0);
+		results.push_back(Benchmark::run("sphere_intersection_with", BATCH, [&] {
+			for (const Ray& ray : rays) {Benchmark::keep(sphere.intersectionWith(ray));}
+		}, options.minSeconds));
+		results.push_back(Benchmark::run("sphere_primitive_distance", BATCH, [&] {
+			for (const Ray& ray : rays) {Benchmark::keep(spherePrimitive.intersectDistance(ray));}
+		}, options.minSeconds));
+		results.push_back(Benchmark::run("plane_intersection_with", BATCH, [&] {
+			for (const Ray& ray : rays) {Benchmark::keep(plane.intersectionWith(ray));}
+		}, options.minSeconds));
+		results.push_back(Benchmark::run("plane_primitive_distance", BATCH, [&] {
+			for (const Ray& ray : rays) {Benchmark::keep(planePrimitive.intersectDistance(ray));}
+		}, options.minSeconds));
+
+		const Camera camera(CameraSettings(), 1024, 768);
+		std::vector<Ray> row;
+		row.reserve(1024);
+		results.push_back(Benchmark::run("camera_cast_ray", 1024, [&] {
+			for (int x = 0; x < 1024; ++x) {Benchmark::keep(camera.castRay(x, 384));}
+		}, options.minSeconds));
+		results.push_back(Benchmark::run("camera_cast_rays_row", 1024, [&] {
+			row.clear();
+			camera.castRays(0, 1024, 384, row);
+			Benchmark::keep(row.back());
+		}, options.minSeconds));
+
+		// Primary rays of a block of pixels in the middle of a 320x240 image, traced one at a time and then in the
+		// renderer's 2x2 packets, per ray
+		constexpr int BLOCK = 64;
+		Scene ballField = SceneGenerator::generate("ball_field", 10000, 1);
+		ballField.commit();
+		const Camera sceneCamera(ballField.getCamera(), 320, 240);
+		std::vector<Ray> primary;
+		primary.reserve(BLOCK * BLOCK);
+		for (int y = 120 - BLOCK / 2; y < 120 + BLOCK / 2; ++y) {
+			sceneCamera.castRays(160 - BLOCK / 2, 160 + BLOCK / 2, y, primary);
+		}
+		results.push_back(Benchmark::run("primary_rays_single", BLOCK * BLOCK, [&] {
+			for (const Ray& ray : primary) {Benchmark::keep(ballField.intersect(ray));}
+		}, options.minSeconds));
+		results.push_back(Benchmark::run("primary_rays_packets", BLOCK * BLOCK, [&] {
+			for (int y = 0; y < BLOCK; y += 2) {
+				for (int x = 0; x < BLOCK; x += 2) {
+					const std::array<Ray, RayPacket::SIZE> block = {primary[y * BLOCK + x], primary[y * BLOCK + x + 1],
+						primary[(y + 1) * BLOCK + x], primary[(y + 1) * BLOCK + x + 1]};
+					Benchmark::keep(ballField.intersect(RayPacket(block, RayPacket::ALL_LANES)));
+				}
+			}
+		}, options.minSeconds));
+
+		// Tone mapping over a spread of linear values, per value
+		std::vector<float> linear(BATCH), scratch(BATCH);
+		std::vector<std::uint8_t> codes(BATCH);
+		for (int i = 0; i < BATCH; ++i) {linear[i] = 4 * static_cast<float>(i) / BATCH;}
+		Tonemap tonemap;
+		results.push_back(Benchmark::run("tonemap_exact", BATCH, [&] {
+			for (const float value : linear) {Benchmark::keep(tonemap.apply(value));}
+		}, options.minSeconds));
+		results.push_back(Benchmark::run("tonemap_encode", BATCH, [&] {
+			tonemap.encode(linear.data(), 1, scratch.data(), codes.data(), BATCH);
+			Benchmark::keep(codes[0]);
+		}, options.minSeconds));
+		tonemap.setLookupGamma(true);
+		results.push_back(Benchmark::run("tonemap_encode_lut", BATCH, [&] {
+			tonemap.encode(linear.data(), 1, scratch.data(), codes.data(), BATCH);
+			Benchmark::keep(codes[0]);
+		}, options.minSeconds));
+		return results;
+	}
+
+	// XML for a scene of the given number of randomly placed spheres, with a floor, a light and a camera
+	std::string sceneXml(const int elements, const int seed) {
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<double> position(-100, 100), unit(0, 1);
+		std::uniform_int_distribution<int> channel(0, 255);
+		std::string xml = "<?xml version=\"1.0\"?>\n<scene>\n"
+			"  <camera x=\"0\" y=\"0\" z=\"-250\" lx=\"0\" ly=\"0\" lz=\"0\" fov=\"60\"/>\n"
+			"  <ambient-light colour=\"#ffffff\" intensity=\"0.05\"/>\n"
+			"  <plane x=\"0\" y=\"-110\" z=\"0\" nx=\"0\" ny=\"1\" nz=\"0\" colour=\"#cccccc\"/>\n"
+			"  <point-light x=\"0\" y=\"200\" z=\"-100\" colour=\"#ffffff\" intensity=\"100000\"/>\n";
+		char line[256];
+		for (int i = 0; i < elements; ++i) {
+			const int length = std::snprintf(line, sizeof(line), "  <sphere x=\"%.4f\" y=\"%.4f\" z=\"%.4f\" radius=\"%.3f\" "
+				"colour=\"#%02x%02x%02x\" reflectivity=\"%.2f\"/>\n", position(random), position(random), position(random),
+				0.2 + unit(random), channel(random), channel(random), channel(random), unit(random));
+			xml.append(line, length);
+		}
+		xml += "</scene>\n";
+		return xml;
+	}
+
+	/*
+	 * Load the same scene from XML, on one thread and on every thread, and from its binary form, timing each from
+	 * text to a committed scene
+	 */
+	std::vector<LoadResult> runLoading(const Options& options) {
+		using Clock = std::chrono::steady_clock;
+		const unsigned threads = threadCount(options);
+		const std::string xml = sceneXml(options.loadElements, options.seed);
+		std::vector<LoadResult> results;
+
+		Clock::time_point start = Clock::now();
+		const Scene scene = SceneLoader(xml, "generated").getScene();
+		results.push_back({"xml", 1, options.loadElements, xml.size(),
+			std::chrono::duration<double>(Clock::now() - start).count()});
+		if (threads > 1) {
+			start = Clock::now();
+			Benchmark::keep(SceneLoader(xml, "generated", threads).getScene());
+			results.push_back({"xml", threads, options.loadElements, xml.size(),
+				std::chrono::duration<double>(Clock::now() - start).count()});
+		}
+
+		const std::filesystem::path path = std::filesystem::temp_directory_path() / "rt_bench_load.rtscene";
+		SceneFile::save(scene, path.string());
+		start = Clock::now();
+		Benchmark::keep(SceneFile::load(path.string()));
+		results.push_back({"rtscene", 1, options.loadElements, std::filesystem::file_size(path),
+			std::chrono::duration<double>(Clock::now() - start).count()});
+		std::filesystem::remove(path);
+		return results;
+	}
+
+	SceneResult runScene(const Options& options, const std::string& name, const int size) {
+		SceneResult result;
+		result.name = name;
+		result.size = size;
+		Scene scene = SceneGenerator::generate(name, size, options.seed);
+		const auto buildStart = std::chrono::steady_clock::now();
+		scene.commit(threadCount(options));
+		result.buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - buildStart).count();
+
+		Renderer renderer(options.width, options.height, options.bounces);
+		if (options.threads > 0) renderer.setThreads(options.threads);
+		renderer.setLightSamples(options.lightSamples);
+		renderer.setPacketTracing(options.packets);
+		renderer.setVerbose(false);
+		Framebuffer frame(options.width, options.height);
+		// One frame to warm the caches before anything is measured
+		renderer.render(scene, frame);
+
+		const std::uint64_t allocations = CountingAllocator::count([&] {
+			for (int i = 0; i < options.frames; ++i) {
+				renderer.render(scene, frame);
+				result.frameSeconds += renderer.getLastReport().seconds;
+				const RenderStats::Counters& stats = renderer.getLastReport().stats;
+				result.rays += stats.get(RenderStats::Counter::PrimaryRays) +
+					stats.get(RenderStats::Counter::ReflectionRays) + stats.get(RenderStats::Counter::ShadowRays);
+			}
+		});
+
+		const double pixels = static_cast<double>(options.width) * options.height * options.frames;
+		result.allocationsPerFrame = static_cast<double>(allocations) / options.frames;
+		result.primaryMraysPerSecond = pixels / result.frameSeconds / 1e6;
+		result.nsPerPixel = result.frameSeconds * 1e9 / pixels;
+		result.frameSeconds /= options.frames;
+		return result;
+	}
+
+	// A binary PPM, with the precision and time per frame that produced it in a comment after the magic number
+	void writePrecisionImage(const std::string& path, const PrecisionImage& image) {
+		std::ofstream out(path, std::ios::binary);
+		if (!out) throw std::runtime_error("cannot open " + path + " for writing");
+		out << "P6\n# rt_bench " << image.precision << " " << image.seed << " " << image.bounces << " " << image.frameSeconds
+			<< "\n" << image.width << " "
+			<< image.height << "\n255\n";
+		out.write(reinterpret_cast<const char*>(image.pixels.data()), static_cast<std::streamsize>(image.pixels.size()));
+		if (!out) throw std::runtime_error("failed writing " + path);
+	}
+
+	// Read an image written by writePrecisionImage, returning false if the file is not one
+	bool readPrecisionImage(const std::string& path, PrecisionImage& image) {
+		std::ifstream in(path, std::ios::binary);
+		if (!in) return false;
+		std::string magic, hash, tag;
+		int maxValue = 0;
+		in >> magic >> hash >> tag >> image.precision >> image.seed >> image.bounces >> image.frameSeconds >> image.width
+			>> image.height >> maxValue;
+		if (!in || magic != "P6" || hash != "#" || tag != "rt_bench" || maxValue != 255 || image.width <= 0 ||
+			image.height <= 0) {
+			return false;
+		}
+		in.get();
+		image.pixels.resize(static_cast<size_t>(image.width) * image.height * 3);
+		in.read(reinterpret_cast<char*>(image.pixels.data()), static_cast<std::streamsize>(image.pixels.size()));
+		return static_cast<bool>(in);
+	}
+
+	/*
+	 * Render the precision scene, write this build's image of it and compare it against the other precision build's
+	 * image if that has been written already. Precision is fixed at build time, so running rt_bench and rt_bench_float
+	 * one after the other gives both timings and the difference between their images.
+	 */
+	PrecisionResult runPrecision(const Options& options) {
+		PrecisionResult result;
+		PrecisionImage& image = result.image;
+		image.precision = PRECISION;
+		image.width = options.width;
+		image.height = options.height;
+		image.seed = options.seed;
+		image.bounces = options.bounces;
+		Scene scene = SceneGenerator::generate(PRECISION_SCENE, PRECISION_SIZE, options.seed);
+		scene.commit();
+
+		Renderer renderer(options.width, options.height, options.bounces);
+		if (options.threads > 0) renderer.setThreads(options.threads);
+		renderer.setVerbose(false);
+		Framebuffer frame(options.width, options.height);
+		renderer.render(scene, frame);
+		for (int i = 0; i < options.frames; ++i) {
+			frame.clear();
+			renderer.render(scene, frame);
+			image.frameSeconds += renderer.getLastReport().seconds;
+		}
+		image.frameSeconds /= options.frames;
+		image.pixels.resize(static_cast<size_t>(options.width) * options.height * 3);
+		Resolve::resolve(frame, renderer.getTonemap(), PixelFormat::RGB24, image.pixels.data(), options.width * 3,
+			options.height);
+		writePrecisionImage(options.precisionImage, image);
+
+		PrecisionImage other;
+		if (!std::filesystem::exists(options.precisionReference)) {
+			result.note = "no " + std::string(OTHER_PRECISION) + " image at " + options.precisionReference + " to compare against yet";
+			return result;
+		}
+		// An image left over from a run with other settings is skipped rather than failing the whole benchmark
+		if (!readPrecisionImage(options.precisionReference, other) || other.precision != OTHER_PRECISION || other.width != image.width || other.height != image.height ||
+			other.seed != image.seed || other.bounces != image.bounces) {
+			result.note = options.precisionReference + " is not a " + OTHER_PRECISION + " image with the same size, seed "
+				"and bounces, so it is not compared";
+			return result;
+		}
+		result.compared = true;
+		result.otherFrameSeconds = other.frameSeconds;
+		std::uint64_t total = 0;
+		for (size_t i = 0; i < image.pixels.size(); ++i) {
+			const int difference = std::abs(image.pixels[i] - other.pixels[i]);
+			total += difference;
+			result.maxDifference = std::max(result.maxDifference, difference);
+			if (difference > 8) result.channelsOver8++;
+		}
+		result.meanDifference = static_cast<double>(total) / static_cast<double>(image.pixels.size());
+		return result;
+	}
+
+	void writeJson(std::ostream& out, const Options& options, const std::vector<Benchmark::Result>& micro,
+		const std::vector<LoadResult>& loading, const std::vector<SceneResult>& scenes, const PrecisionResult& precision) {
+		out << "{\n  \"build\": {\"precision\": \"" << PRECISION
+			<< "\", \"stats\": " << (RenderStats::ENABLED ? "true" : "false") << ", \"compiler\": \"" << __VERSION__ << "\"},\n";
+		out << "  \"microbenchmarks\": [\n";
+		for (size_t i = 0; i < micro.size(); ++i) {
+			out << "    {\"name\": \"" << micro[i].name << "\", \"ns_per_op\": " << micro[i].nsPerOperation
+				<< ", \"operations\": " << micro[i].operations << "}" << (i + 1 < micro.size() ? "," : "") << "\n";
+		}
+		out << "  ],\n  \"loading\": [\n";
+		for (size_t i = 0; i < loading.size(); ++i) {
+			out << "    {\"format\": \"" << loading[i].format << "\", \"threads\": " << loading[i].threads
+				<< ", \"elements\": " << loading[i].elements
+				<< ", \"bytes\": " << loading[i].bytes << ", \"seconds\": " << loading[i].seconds
+				<< ", \"elements_per_second\": " << loading[i].elements / loading[i].seconds << "}"
+				<< (i + 1 < loading.size() ? "," : "") << "\n";
+		}
+		out << "  ],\n  \"scenes\": [\n";
+		for (size_t i = 0; i < scenes.size(); ++i) {
+			const SceneResult& scene = scenes[i];
+			out << "    {\"name\": \"" << scene.name << "\", \"size\": " << scene.size << ", \"seed\": " << options.seed
+				<< ", \"width\": " << options.width
+				<< ", \"height\": " << options.height << ", \"bounces\": " << options.bounces << ", \"packets\": "
+				<< (options.packets ? "true" : "false") << ", \"build_threads\": "
+				<< threadCount(options) << ", \"build_seconds\": " << scene.buildSeconds << ", \"frame_seconds\": " << scene.frameSeconds << ", \"primary_mrays_per_second\": "
+				<< scene.primaryMraysPerSecond << ", \"ns_per_pixel\": " << scene.nsPerPixel
+				<< ", \"allocations_per_frame\": " << scene.allocationsPerFrame;
+			if (RenderStats::ENABLED) {
+				out << ", \"mrays_per_second\": " << scene.rays / (scene.frameSeconds * options.frames) / 1e6;
+			}
+			out << "}" << (i + 1 < scenes.size() ? "," : "") << "\n";
+		}
+		out << "  ],\n  \"precision\": {\"scene\": \"" << PRECISION_SCENE << "\", \"size\": " << PRECISION_SIZE
+			<< ", \"" << PRECISION << "_frame_seconds\": " << precision.image.frameSeconds;
+		if (precision.compared) {
+			out << ", \"" << OTHER_PRECISION << "_frame_seconds\": " << precision.otherFrameSeconds
+				<< ", \"mean_difference\": " << precision.meanDifference << ", \"max_difference\": "
+				<< precision.maxDifference << ", \"channels_over_8\": " << precision.channelsOver8;
+		}
+		out << "}\n}" << std::endl;
+	}
+}
+
+int main(const int argc, char* argv[]) {
+	try {
+		const Options options = parseOptions(argc, argv);
+
+		const std::vector<Benchmark::Result> micro = runMicrobenchmarks(options);
+		for (const Benchmark::Result& result : micro) {
+			std::printf("%-28s %10.2f ns/op\n", result.name.c_str(), result.nsPerOperation);
+		}
+
+		const std::vector<LoadResult> loading = runLoading(options);
+		for (const LoadResult& result : loading) {
+			std::printf("load %-7s %2u threads %-9d %8.3fs  %8.1f MB  %10.0f elements/s\n", result.format.c_str(),
+				result.threads, result.elements, result.seconds, result.bytes / 1e6, result.elements / result.seconds);
+		}
+
+		std::vector<SceneResult> scenes;
+		for (const std::string& name : options.scenes) {
+			for (const int size : options.sizes) {
+				scenes.push_back(runScene(options, name, size));
+				const SceneResult& scene = scenes.back();
+				std::printf("%-16s %-9d build %8.3fs  frame %8.4fs  %8.3f primary Mrays/s  %9.1f ns/pixel  %8.1f allocs/frame\n",
+					scene.name.c_str(), scene.size, scene.buildSeconds, scene.frameSeconds, scene.primaryMraysPerSecond,
+					scene.nsPerPixel, scene.allocationsPerFrame);
+			}
+		}
+
+		const PrecisionResult precision = runPrecision(options);
+		std::printf("precision %-6s %s %d  frame %8.4fs\n", PRECISION, PRECISION_SCENE, PRECISION_SIZE,
+			precision.image.frameSeconds);
+		if (precision.compared) {
+			std::printf("precision %-6s %s %d  frame %8.4fs  mean difference %.4f  max %d  %llu channels over 8\n",
+				OTHER_PRECISION, PRECISION_SCENE, PRECISION_SIZE, precision.otherFrameSeconds, precision.meanDifference,
+				precision.maxDifference, static_cast<unsigned long long>(precision.channelsOver8));
+		} else {
+			std::printf("precision: %s\n", precision.note.c_str());
+		}
+
+		std::ofstream json(options.jsonPath);
+		if (!json) throw std::runtime_error("cannot open " + options.jsonPath + " for writing");
+		writeJson(json, options, micro, loading, scenes, precision);
+		std::printf("Wrote %s\n", options.jsonPath.c_str());
+	} catch (const std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -1,4 +1,167 @@
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <fstream>
 #include <iostream>
-int main() {
+#include <stdexcept>
+#include <string>
+#include <thread>
 
-}
\ No newline at end of file
+#include "ImageWriter.h"
+#include "Renderer.h"
+#include "SceneFile.h"
+#include "SceneGenerator.h"
+#include "SceneLoader.h"
+
+// Headless driver: load a scene, render it and stream the image to disk, without needing a display
+namespace {
+	void printUsage(const char* program) {
+		std::cerr << "Usage: " << program << " <scene.xml|scene.rtscene> [options]\n"
+			<< "       " << program << " --generate <name> [--size <n>] [--seed <n>] [options]\n"
+			<< "  --generate <name> render a generated scene instead: sphereflake, ball_field, reflective_grid or\n"
+			<< "                    many_light_room\n"
+			<< "  --size <n>        primitives in the generated scene, lights for many_light_room (default 1000)\n"
+			<< "  --seed <n>        seed of the generated scene (default 1)\n"
+			<< "  --convert <file>  write the scene as a binary .rtscene file instead of rendering it\n"
+			<< "  --no-bvh          leave the BVH out of the converted scene, to be rebuilt when it is loaded\n"
+			<< "  --output <file>   image to write, .ppm, .png or .qoi (default render.png)\n"
+			<< "  --width <n>       image width in pixels (default 800)\n"
+			<< "  --height <n>      image height in pixels (default 600)\n"
+			<< "  --bounces <n>     reflection bounces per ray (default 2)\n"
+			<< "  --threads <n>     worker threads (default: one per hardware thread)\n"
+			<< "  --tile <n>        tile size in pixels (default 32)\n"
+			<< "  --light-samples <n>  lights sampled per shading point, 0 for every light (default 0)\n"
+			<< "  --light-cutoff <t>   illumination below which lights are cut off and culled per tile (default: none);\n"
+			<< "                    light samples are then drawn from each tile's own lights\n"
+			<< "  --brightness <a>  tone mapping brightness (default 2)\n"
+			<< "  --contrast <b>    tone mapping contrast (default 1.3)\n"
+			<< "  --gamma <g>       display gamma (default 2.2)\n"
+			<< "  --gamma-lut       encode gamma with a lookup table, within one code of the exact curve; gammas below\n"
+			<< "                    about 0.1, where the table cannot keep to that, use the exact curve anyway\n"
+			<< "  --wavefront       trace tiles breadth first instead of recursively\n"
+			<< "  --no-packets      trace primary rays one at a time\n"
+			<< "  --stats-json <file>  write the frame statistics as JSON\n";
+	}
+
+	int parseInteger(const std::string& option, const char* value, const int minimum) {
+		size_t end = 0;
+		int number = 0;
+		try {
+			number = std::stoi(value, &end);
+		} catch (const std::exception&) {
+			end = 0;
+		}
+		if (end != std::strlen(value) || number < minimum) {
+			throw std::invalid_argument(option + " expects an integer of at least " + std::to_string(minimum) + ", got '" +
+				value + "'");
+		}
+		return number;
+	}
+
+	float parsePositiveFloat(const std::string& option, const char* value) {
+		size_t end = 0;
+		float number = 0;
+		try {
+			number = std::stof(value, &end);
+		} catch (const std::exception&) {
+			end = 0;
+		}
+		if (end != std::strlen(value) || !(number > 0)) {
+			throw std::invalid_argument(option + " expects a positive number, got '" + value + "'");
+		}
+		return number;
+	}
+}
+
+int main(const int argc, char* argv[]) {
+	std::string scenePath, generator, outputPath = "render.png", statsPath, convertPath;
+	int generatedSize = 1000, seed = 1;
+	int width = 800, height = 600, bounces = 2, tileSize = 32, lightSamples = 0;
+	unsigned threads = 0;
+	float lightCutoff = 0, brightness = 2, contrast = 1.3f, gamma = 2.2f;
+	bool wavefront = false, packets = true, gammaLookup = false, saveHierarchy = true;
+
+	try {
+		for (int i = 1; i < argc; ++i) {
+			const std::string arg = argv[i];
+			// Options that take a value
+			auto value = [&]() -> const char* {
+				if (i + 1 >= argc) throw std::invalid_argument(arg + " expects a value");
+				return argv[++i];
+			};
+			if (arg == "--help" || arg == "-h") {
+				printUsage(argv[0]);
+				return 0;
+			}
+			if (arg == "--output" || arg == "-o") outputPath = value();
+			else if (arg == "--generate") generator = value();
+			else if (arg == "--size") generatedSize = parseInteger(arg, value(), 1);
+			else if (arg == "--seed") seed = parseInteger(arg, value(), 0);
+			else if (arg == "--convert") convertPath = value();
+			else if (arg == "--no-bvh") saveHierarchy = false;
+			else if (arg == "--width") width = parseInteger(arg, value(), 1);
+			else if (arg == "--height") height = parseInteger(arg, value(), 1);
+			else if (arg == "--bounces") bounces = parseInteger(arg, value(), 0);
+			else if (arg == "--threads") threads = parseInteger(arg, value(), 1);
+			else if (arg == "--tile") tileSize = parseInteger(arg, value(), 1);
+			else if (arg == "--light-samples") lightSamples = parseInteger(arg, value(), 0);
+			else if (arg == "--light-cutoff") lightCutoff = parsePositiveFloat(arg, value());
+			else if (arg == "--brightness") brightness = parsePositiveFloat(arg, value());
+			else if (arg == "--contrast") contrast = parsePositiveFloat(arg, value());
+			else if (arg == "--gamma") gamma = parsePositiveFloat(arg, value());
+			else if (arg == "--gamma-lut") gammaLookup = true;
+			else if (arg == "--wavefront") wavefront = true;
+			else if (arg == "--no-packets") packets = false;
+			else if (arg == "--stats-json") statsPath = value();
+			else if (arg.starts_with("-")) throw std::invalid_argument("unknown option " + arg);
+			else if (scenePath.empty()) scenePath = arg;
+			else throw std::invalid_argument("more than one scene given");
+		}
+		if (scenePath.empty() == generator.empty()) {
+			printUsage(argv[0]);
+			return 1;
+		}
+
+		// Loading and building the BVH use as many threads as rendering
+		const unsigned loadThreads = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+		const Scene scene = [&] {
+			if (!generator.empty()) {
+				Scene generated = SceneGenerator::generate(generator, generatedSize, seed);
+				generated.commit(loadThreads);
+				return generated;
+			}
+			if (SceneFile::isSceneFile(scenePath)) return SceneFile::load(scenePath, loadThreads);
+			return SceneLoader(scenePath, loadThreads).getScene();
+		}();
+		if (!convertPath.empty()) {
+			SceneFile::save(scene, convertPath, saveHierarchy);
+			std::cout << "Wrote " << convertPath << std::endl;
+			return 0;
+		}
+
+		Renderer renderer(width, height, bounces);
+		if (threads > 0) renderer.setThreads(threads);
+		renderer.setTileSize(tileSize);
+		renderer.setLightSamples(lightSamples);
+		renderer.setLightCutoff(lightCutoff);
+		renderer.setWavefront(wavefront);
+		renderer.setPacketTracing(packets);
+		Tonemap tonemap(brightness, contrast, gamma);
+		tonemap.setLookupGamma(gammaLookup);
+		renderer.setTonemap(tonemap);
+
+		// Open the output before rendering so a bad path fails straight away
+		const std::unique_ptr<ImageWriter> writer = ImageWriter::forPath(outputPath);
+		renderer.render(scene, *writer);
+		std::cout << "Wrote " << outputPath << std::endl;
+		if (!statsPath.empty()) {
+			std::ofstream stats(statsPath);
+			if (!stats) throw std::runtime_error("cannot open " + statsPath + " for writing");
+			renderer.getLastReport().printJson(stats);
+		}
+	} catch (const std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
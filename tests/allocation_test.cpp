@@ -0,0 +1,124 @@
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Camera.h"
+#include "ColorRGB.h"
+#include "Framebuffer.h"
+#include "Intersection.h"
+#include "RaycastHit.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "SceneGenerator.h"
+#include "bench/CountingAllocator.h"
+
+/*
+ * Checks that tracing and shading rays makes no heap allocations once a scene is committed, since any allocation on
+ * the per ray path costs far more than the work around it and serialises the render threads on the allocator.
+ */
+namespace {
+	// Opens up the renderer's shading so it can be called on single rays outside of a frame
+	class ShadingRenderer final : public Renderer {
+	public:
+		using Renderer::Renderer;
+		using Renderer::shade;
+		using Renderer::sceneLights;
+	};
+
+	// Keep a value alive so the work producing it is not optimised away
+	template <typename T>
+	void keep(const T& value) {
+		asm volatile("" : : "r"(&value) : "memory");
+	}
+
+	int failures = 0;
+
+	void expect(const std::string& name, const std::uint64_t unexpectedAllocations) {
+		if (unexpectedAllocations == 0) {
+			std::printf("ok    %s\n", name.c_str());
+		} else {
+			const auto count = static_cast<unsigned long long>(unexpectedAllocations);
+			std::printf("FAIL  %s: %llu allocations\n", name.c_str(), count);
+			failures++;
+		}
+	}
+
+	// Run body with allocations counted, failing the test if it made any
+	template <typename Body>
+	void expectNoAllocations(const std::string& name, Body&& body) {
+		expect(name, CountingAllocator::count(body));
+	}
+
+	// Camera rays covering the whole image, so they hit every kind of primitive in the scene and miss some too
+	std::vector<Ray> cameraRays(const Scene& scene, const int width, const int height) {
+		const Camera camera(scene.getCamera(), width, height);
+		std::vector<Ray> rays;
+		rays.reserve(static_cast<size_t>(width) * height);
+		for (int y = 0; y < height; ++y) {camera.castRays(0, width, y, rays);}
+		return rays;
+	}
+
+	void checkScene(const std::string& name, const int lightSamples) {
+		constexpr int WIDTH = 64, HEIGHT = 48, BOUNCES = 2;
+		Scene scene = SceneGenerator::generate(name, 200, 1);
+		scene.commit();
+		const std::vector<Ray> rays = cameraRays(scene, WIDTH, HEIGHT);
+		std::vector<Intersection> intersections(rays.size());
+		ShadingRenderer renderer(WIDTH, HEIGHT, BOUNCES);
+		renderer.setLightSamples(lightSamples);
+		const std::string label = name + (lightSamples > 0 ? " sampled" : "");
+
+		expectNoAllocations(label + " intersect", [&] {
+			for (size_t i = 0; i < rays.size(); ++i) {intersections[i] = scene.intersect(rays[i]);}
+		});
+		expectNoAllocations(label + " isOccluded", [&] {
+			for (const Ray& ray : rays) {keep(scene.isOccluded(ray, 100));}
+		});
+		expectNoAllocations(label + " resolve", [&] {
+			for (size_t i = 0; i < rays.size(); ++i) {
+				if (intersections[i].isHit()) keep(scene.resolve(rays[i], intersections[i]));
+			}
+		});
+		expectNoAllocations(label + " shade", [&] {
+			for (size_t i = 0; i < rays.size(); ++i) {
+				keep(renderer.shade(scene, ShadingRenderer::sceneLights(scene), rays[i], intersections[i], BOUNCES));
+			}
+		});
+	}
+
+	/*
+	 * Rendering a frame allocates for its tiles and threads, but culling the lights of every tile must add nothing to
+	 * that once a first frame has grown each thread's storage for the culled lights and their tree.
+	 */
+	void checkFrameCulling() {
+		constexpr int WIDTH = 64, HEIGHT = 48, BOUNCES = 2;
+		Scene scene = SceneGenerator::generate("many_light_room", 200, 1);
+		scene.commit();
+		Framebuffer frame(WIDTH, HEIGHT);
+		auto secondFrameAllocations = [&](const Real lightCutoff) {
+			Renderer renderer(WIDTH, HEIGHT, BOUNCES);
+			renderer.setThreads(1);
+			renderer.setTileSize(16);
+			renderer.setVerbose(false);
+			renderer.setLightSamples(4);
+			renderer.setLightCutoff(lightCutoff);
+			renderer.render(scene, frame);
+			return CountingAllocator::count([&] {renderer.render(scene, frame);});
+		};
+		const std::uint64_t unculled = secondFrameAllocations(0);
+		const std::uint64_t culled = secondFrameAllocations(0.5);
+		expect("many_light_room culled frame", culled > unculled ? culled - unculled : 0);
+	}
+}
+
+int main() {
+	for (const char* name : SceneGenerator::NAMES) {checkScene(name, 0);}
+	checkScene("many_light_room", 4);
+	checkFrameCulling();
+	if (failures > 0) {
+		std::printf("%d checks allocated\n", failures);
+		return 1;
+	}
+	return 0;
+}